@@ -383,7 +383,7 @@ void GameTechVulkanRenderer::UpdateObjectList() {
 					activeObjects.emplace_back(g);
 
 					ObjectState state;
-					state.modelMatrix = g->GetTransform()->GetMatrix();
+					state.modelMatrix = g->GetModelMatrix();
 					state.colour = g->GetColour();
 					state.index[0] = 0;
 					if (g->GetMesh()) {
@@ -24,6 +24,9 @@ TutorialGame::TutorialGame() : controller(*Window::GetWindow()->GetKeyboard(), *
 #endif
 
 	physics		= new PhysicsSystem(*world);
+	physicsThread	= new PhysicsThread(*physics, *world);
+	threadedPhysics = false;
+	physics->SetInterpolation(true);
 
 	forceMagnitude	= 10.0f;
 	useGravity		= false;
@@ -78,12 +81,17 @@ TutorialGame::~TutorialGame()	{
 	delete basicTex;
 	delete basicShader;
 
+	delete physicsThread;
 	delete physics;
 	delete renderer;
 	delete world;
 }
 
 void TutorialGame::UpdateGame(float dt) {
+	if (threadedPhysics) {
+		physicsThread->Finish(); //Last frame's physics has to be done before we can touch the world
+		physics->DispatchCollisionEvents();
+	}
 	if (!inSelectionMode) {
 		world->GetMainCamera().UpdateCamera(dt);
 	}
@@ -224,7 +232,16 @@ void TutorialGame::UpdateGame(float dt) {
 
 	world->UpdateWorld(dt);
 	renderer->Update(dt);
-	physics->Update(dt);
+	if (threadedPhysics) {
+		world->UpdateTransforms(); //Must be done before the physics thread starts moving things again
+		physicsThread->Begin(dt); //Runs alongside the rendering below
+	}
+	else {
+		physics->Update(dt);
+		physics->DispatchCollisionEvents();
+		physics->UpdateRenderTransforms();
+		world->UpdateTransforms();
+	}
 
 	renderer->Render();
 	Debug::UpdateRenderables(dt);
@@ -244,6 +261,40 @@ void TutorialGame::UpdateKeys() {
 		useGravity = !useGravity; //Toggle gravity!
 		physics->UseGravity(useGravity);
 	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::T)) {
+		threadedPhysics = !threadedPhysics; //Toggle running physics alongside rendering
+		if (!threadedPhysics) {
+			physicsThread->ClearSnapshots();
+		}
+		std::cout << "Setting threaded physics to " << threadedPhysics << std::endl;
+	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::B)) {
+		physics->UseBroadPhase(!physics->IsUsingBroadPhase());
+		std::cout << "Setting broadphase to " << physics->IsUsingBroadPhase() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::N)) {
+		switch (physics->GetBroadPhase()) {
+			case BroadPhaseType::QuadTree:		physics->SetBroadPhase(BroadPhaseType::AABBTree);		break;
+			case BroadPhaseType::AABBTree:		physics->SetBroadPhase(BroadPhaseType::SweepAndPrune);	break;
+			case BroadPhaseType::SweepAndPrune:	physics->SetBroadPhase(BroadPhaseType::QuadTree);		break;
+		}
+		std::cout << "Setting broad container to " << (int)physics->GetBroadPhase() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::I)) {
+		physics->SetConstraintIterationCount(std::max(physics->GetConstraintIterationCount() - 1, 1));
+		std::cout << "Setting constraint iterations to " << physics->GetConstraintIterationCount() << std::endl;
+	}
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::O)) {
+		physics->SetConstraintIterationCount(physics->GetConstraintIterationCount() + 1);
+		std::cout << "Setting constraint iterations to " << physics->GetConstraintIterationCount() << std::endl;
+	}
+
+	if (Window::GetKeyboard()->KeyPressed(KeyCodes::F3)) {
+		physics->SetInterpolation(!physics->IsInterpolating()); //Toggle drawing objects between physics steps
+		std::cout << "Setting render interpolation to " << physics->IsInterpolating() << std::endl;
+	}
 	//Running certain physics updates in a consistent order might cause some
 	//bias in the calculations - the same objects might keep 'winning' the constraint
 	//allowing the other one to stretch too much etc. Shuffling the order so that it
@@ -637,6 +688,7 @@ void TutorialGame::InitButton() {
 	gate = AddCubeToWorld(Vector3(220, -5, 350), Vector3(50, 10, 5), 1.0f);
 	gate->GetRenderObject()->SetColour(Vector4(1, 0, 1, 1));
 	gate->GetPhysicsObject()->SetInverseMass(0);
+	gate->GetPhysicsObject()->SetKinematic(true); //It gets moved out of the way when the button is pressed
 }
 
 void TutorialGame::InitRacer() {
@@ -705,6 +757,7 @@ void TutorialGame::InitSphereGridWorld(int numRows, int numCols, float rowSpacin
 		for (int z = 0; z < numRows; ++z) {
 			Vector3 position = spawn + Vector3(x * colSpacing, 50.0f, z * rowSpacing);
 			GameObject* sphere = AddSphereToWorld(position, radius, 1.0f);
+			sphere->GetPhysicsObject()->SetFastMoving(true);
 			spheres.push_back(sphere);
 		}
 	}
@@ -846,62 +899,56 @@ void TutorialGame::MoveSelectedObject() {
 	}
 }
 
+/*
+Rather than testing the player against every kitten and coin, we ask the
+world what the player is touching, and then see what those things are.
+*/
 void TutorialGame::CatCollision() {
-	CollisionDetection::CollisionInfo info;
+	const size_t maxOverlaps = 32;
+	GameObject* overlaps[maxOverlaps];
 
-	for (auto i = kittens.begin(); i != kittens.end();) {
-		GameObject* kitten = *i;
+	size_t count = world->OverlapObject(*playerChar, overlaps, maxOverlaps);
+	for (size_t j = 0; j < count; ++j) {
+		GameObject* o = overlaps[j];
 
-		if (CollisionDetection::ObjectIntersection(playerChar, kitten, info)) {
-			kitten->GetTransform().SetPosition(Vector3(10, -50, 15));
+		auto kitten = std::find(kittens.begin(), kittens.end(), o);
+		if (kitten != kittens.end()) {
+			o->GetTransform().SetPosition(Vector3(10, -50, 15));
+			o->GetPhysicsObject()->Wake();
 			rescued += 1;
 			score += 2000;
-
-			i = kittens.erase(i);
-		}
-		else {
-			++i;
+			kittens.erase(kitten);
+			continue;
 		}
-	}
-	for (auto i = coins.begin(); i != coins.end();) {
-		GameObject* coin = *i;
-
-		if (CollisionDetection::ObjectIntersection(playerChar, coin, info)) {
-			coin->GetTransform().SetPosition(Vector3(20, -50, 15));
+		auto coin = std::find(coins.begin(), coins.end(), o);
+		if (coin != coins.end()) {
+			o->GetTransform().SetPosition(Vector3(20, -50, 15));
+			o->GetPhysicsObject()->Wake();
 			score += 1000;
-
-			i = coins.erase(i);
-		}
-		else {
-			++i;
+			coins.erase(coin);
 		}
 	}
-	for (auto i = spheres.begin(); i != spheres.end();) {
-		GameObject* sphere = *i;
 
-		if (CollisionDetection::ObjectIntersection(button, sphere, info)) {
+	count = world->OverlapObject(*button, overlaps, maxOverlaps);
+	for (size_t j = 0; j < count; ++j) {
+		auto sphere = std::find(spheres.begin(), spheres.end(), overlaps[j]);
+		if (sphere != spheres.end()) {
 			gate->GetTransform().SetPosition(Vector3(100, -200, 100));
-
-			i = spheres.erase(i);
-		}
-		else {
-			++i;
+			gate->GetPhysicsObject()->Wake();
+			spheres.erase(sphere);
 		}
 	}
 }
 
 void TutorialGame::EnemyCollision() {
-	CollisionDetection::CollisionInfo info;
-
-	for (auto i = enemies.begin(); i != enemies.end();) {
-		StateGameObject* enemy = *i;
+	const size_t maxOverlaps = 32;
+	GameObject* overlaps[maxOverlaps];
 
-		if (CollisionDetection::ObjectIntersection(playerChar, enemy, info)) {
+	size_t count = world->OverlapObject(*playerChar, overlaps, maxOverlaps);
+	for (size_t j = 0; j < count; ++j) {
+		if (std::find(enemies.begin(), enemies.end(), overlaps[j]) != enemies.end()) {
 			inGame = false;
 		}
-		else {
-			++i;
-		}
 	}
 }
 
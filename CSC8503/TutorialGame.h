@@ -6,6 +6,7 @@
 #include "GameTechVulkanRenderer.h"
 #endif
 #include "PhysicsSystem.h"
+#include "PhysicsThread.h"
 
 #include "StateGameObject.h"
 
@@ -99,6 +100,8 @@ namespace NCL {
 			GameTechRenderer* renderer;
 #endif
 			PhysicsSystem*		physics;
+			PhysicsThread*		physicsThread;
+			bool				threadedPhysics;
 			GameWorld*			world;
 
 			KeyboardMouseController controller;
@@ -0,0 +1,585 @@
+#pragma once
+#include "Vector.h"
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		/*
+		Every node in the tree stores a 'fat' box - the object's real bounds
+		grown by the tree's margin. Leaves hold an object, and internal nodes
+		hold the union of their two children. Unused nodes are kept in a free
+		list, which reuses the parent index as its 'next' link.
+		*/
+		template<class T>
+		struct AABBTreeNode {
+			Vector3 boxMin;
+			Vector3 boxMax;
+			T		object;
+
+			int parent;
+			int left;
+			int right;
+			int height;	//Leaves are at height 0, free nodes at -1
+
+			bool IsLeaf() const {
+				return left == -1;
+			}
+		};
+
+		/*
+		A persistent, incrementally updated bounding volume hierarchy. Unlike
+		the QuadTree, this isn't rebuilt every frame - objects are inserted once,
+		and then only reinserted when their bounds escape the fat box stored in
+		their leaf. Objects that don't move (or only jiggle around a little) cost
+		us a single containment test per update.
+
+		Insertion picks a sibling using a surface area heuristic, and the tree is
+		kept balanced via AVL-style rotations as we walk back up to the root.
+		*/
+		template<class T>
+		class AABBTree {
+		public:
+			static const int NullNode = -1;
+
+			AABBTree(float fatMargin = 1.0f) {
+				margin = fatMargin;
+				Clear();
+			}
+			~AABBTree() {
+			}
+
+			void Clear() {
+				nodes.clear();
+				root		= NullNode;
+				freeList	= NullNode;
+				proxyCount	= 0;
+			}
+
+			int Insert(T object, const Vector3& pos, const Vector3& halfSize) {
+				int proxy = AllocateNode();
+				Vector3 fatSize = halfSize + Vector3(margin, margin, margin);
+
+				nodes[proxy].boxMin = pos - fatSize;
+				nodes[proxy].boxMax = pos + fatSize;
+				nodes[proxy].object = object;
+				nodes[proxy].height = 0;
+
+				InsertLeaf(proxy);
+				proxyCount++;
+				return proxy;
+			}
+
+			void Remove(int proxy) {
+				RemoveLeaf(proxy);
+				FreeNode(proxy);
+				proxyCount--;
+			}
+
+			/*
+			Returns true if the object escaped its fat box and had to be
+			reinserted into the tree.
+			*/
+			bool Update(int proxy, const Vector3& pos, const Vector3& halfSize) {
+				Vector3 tightMin = pos - halfSize;
+				Vector3 tightMax = pos + halfSize;
+
+				const AABBTreeNode<T>& n = nodes[proxy];
+				if (n.boxMin.x <= tightMin.x && n.boxMin.y <= tightMin.y && n.boxMin.z <= tightMin.z &&
+					n.boxMax.x >= tightMax.x && n.boxMax.y >= tightMax.y && n.boxMax.z >= tightMax.z) {
+					return false;
+				}
+				RemoveLeaf(proxy);
+
+				Vector3 fatMargin = Vector3(margin, margin, margin);
+				nodes[proxy].boxMin = tightMin - fatMargin;
+				nodes[proxy].boxMax = tightMax + fatMargin;
+
+				InsertLeaf(proxy);
+				return true;
+			}
+
+			/*
+			Calls func(proxy) for every leaf whose fat box overlaps the given
+			box. The traversal stops early if func returns false.
+			*/
+			template<typename Func>
+			void Query(const Vector3& pos, const Vector3& halfSize, Func&& func) const {
+				if (root == NullNode) {
+					return;
+				}
+				Vector3 queryMin = pos - halfSize;
+				Vector3 queryMax = pos + halfSize;
+
+				int stack[MaxStackDepth];
+				int stackSize = 0;
+				stack[stackSize++] = root;
+
+				while (stackSize > 0) {
+					int index = stack[--stackSize];
+					const AABBTreeNode<T>& n = nodes[index];
+
+					if (!Overlaps(n.boxMin, n.boxMax, queryMin, queryMax)) {
+						continue;
+					}
+					if (n.IsLeaf()) {
+						if (!func(index)) {
+							return;
+						}
+					}
+					else if (stackSize + 2 <= MaxStackDepth) {
+						stack[stackSize++] = n.left;
+						stack[stackSize++] = n.right;
+					}
+				}
+			}
+
+			/*
+			Calls func(proxy, maxDistance) for every leaf the ray passes through
+			within maxDistance, nearest fat box first. func returns the distance
+			the traversal should now give up at - the distance of a hit it just
+			found, say, so anything further away gets pruned - or a negative
+			value to stop straight away.
+			*/
+			template<typename Func>
+			void RayCast(const Vector3& origin, const Vector3& direction, float maxDistance, Func&& func) const {
+				if (root == NullNode) {
+					return;
+				}
+				Vector3 invDir = InverseDirection(direction);
+
+				float entry;
+				if (!RayHitsBox(nodes[root].boxMin, nodes[root].boxMax, origin, invDir, maxDistance, entry)) {
+					return;
+				}
+				struct StackEntry {
+					int		node;
+					float	entry;
+				};
+				StackEntry stack[MaxStackDepth];
+				int stackSize = 0;
+				stack[stackSize++] = { root, entry };
+
+				while (stackSize > 0) {
+					StackEntry e = stack[--stackSize];
+					if (e.entry > maxDistance) {
+						continue; //Something closer was hit after this was pushed
+					}
+					const AABBTreeNode<T>& n = nodes[e.node];
+					if (n.IsLeaf()) {
+						maxDistance = func(e.node, maxDistance);
+						if (maxDistance < 0.0f) {
+							return;
+						}
+						continue;
+					}
+					float entryLeft;
+					float entryRight;
+					bool hitLeft	= RayHitsBox(nodes[n.left].boxMin, nodes[n.left].boxMax, origin, invDir, maxDistance, entryLeft);
+					bool hitRight	= RayHitsBox(nodes[n.right].boxMin, nodes[n.right].boxMax, origin, invDir, maxDistance, entryRight);
+
+					if (stackSize + 2 > MaxStackDepth) {
+						continue;
+					}
+					//Push the nearer child last, so it's visited first
+					if (hitLeft && hitRight && entryLeft < entryRight) {
+						stack[stackSize++] = { n.right, entryRight };
+						stack[stackSize++] = { n.left, entryLeft };
+					}
+					else {
+						if (hitLeft) {
+							stack[stackSize++] = { n.left, entryLeft };
+						}
+						if (hitRight) {
+							stack[stackSize++] = { n.right, entryRight };
+						}
+					}
+				}
+			}
+
+			/*
+			Calls func(proxy, maxDistance) for every leaf whose fat box is within
+			maxDistance of the point, nearest boxes first. As with RayCast, func
+			returns the distance to give up at from then on, or a negative value
+			to stop.
+			*/
+			template<typename Func>
+			void NearestQuery(const Vector3& point, float maxDistance, Func&& func) const {
+				if (root == NullNode) {
+					return;
+				}
+				float distance = BoxDistance(nodes[root].boxMin, nodes[root].boxMax, point);
+				if (distance > maxDistance) {
+					return;
+				}
+				struct StackEntry {
+					int		node;
+					float	distance;
+				};
+				StackEntry stack[MaxStackDepth];
+				int stackSize = 0;
+				stack[stackSize++] = { root, distance };
+
+				while (stackSize > 0) {
+					StackEntry e = stack[--stackSize];
+					if (e.distance > maxDistance) {
+						continue;
+					}
+					const AABBTreeNode<T>& n = nodes[e.node];
+					if (n.IsLeaf()) {
+						maxDistance = func(e.node, maxDistance);
+						if (maxDistance < 0.0f) {
+							return;
+						}
+						continue;
+					}
+					if (stackSize + 2 > MaxStackDepth) {
+						continue;
+					}
+					StackEntry left		= { n.left,  BoxDistance(nodes[n.left].boxMin, nodes[n.left].boxMax, point) };
+					StackEntry right	= { n.right, BoxDistance(nodes[n.right].boxMin, nodes[n.right].boxMax, point) };
+					if (left.distance < right.distance) {
+						std::swap(left, right);
+					}
+					if (left.distance <= maxDistance) {
+						stack[stackSize++] = left;
+					}
+					if (right.distance <= maxDistance) {
+						stack[stackSize++] = right;
+					}
+				}
+			}
+
+			static const int RayPacketSize = 8;
+
+			/*
+			Traces a packet of up to RayPacketSize rays through the tree at once.
+			Each node is only fetched once for the whole packet, and carries a
+			mask of the rays that are still inside it, so rays that start close
+			together and head the same way share almost all of their traversal.
+
+			func(proxy, rayMask) is called for every leaf hit by at least one of
+			the rays, with a bit set for each of them. It should shrink the
+			matching maxDistances entries when it finds a hit, which will then
+			prune the rest of the traversal for those rays.
+			*/
+			template<typename Func>
+			void RayCastPacket(const Vector3* origins, const Vector3* directions, float* maxDistances, int rayCount, Func&& func) const {
+				if (root == NullNode || rayCount <= 0) {
+					return;
+				}
+				rayCount = std::min(rayCount, RayPacketSize);
+
+				Vector3 invDirs[RayPacketSize];
+				for (int i = 0; i < rayCount; ++i) {
+					invDirs[i] = InverseDirection(directions[i]);
+				}
+				struct StackEntry {
+					int				node;
+					unsigned int	rays;
+				};
+				StackEntry stack[MaxStackDepth];
+				int stackSize = 0;
+				stack[stackSize++] = { root, (1u << rayCount) - 1 };
+
+				while (stackSize > 0) {
+					StackEntry e = stack[--stackSize];
+					const AABBTreeNode<T>& n = nodes[e.node];
+
+					unsigned int hits = 0;
+					for (unsigned int rays = e.rays; rays != 0; rays &= rays - 1) {
+						int i = std::countr_zero(rays);
+						float entry;
+						if (RayHitsBox(n.boxMin, n.boxMax, origins[i], invDirs[i], maxDistances[i], entry)) {
+							hits |= 1u << i;
+						}
+					}
+					if (hits == 0) {
+						continue;
+					}
+					if (n.IsLeaf()) {
+						func(e.node, hits);
+						continue;
+					}
+					if (stackSize + 2 > MaxStackDepth) {
+						continue;
+					}
+					//Order the children by the first ray, which should suit the rest of a coherent packet
+					const Vector3& d = directions[std::countr_zero(hits)];
+					Vector3 leftToRight = (nodes[n.right].boxMin + nodes[n.right].boxMax) - (nodes[n.left].boxMin + nodes[n.left].boxMax);
+					if (Vector::Dot(d, leftToRight) > 0.0f) {
+						stack[stackSize++] = { n.right, hits };
+						stack[stackSize++] = { n.left, hits };
+					}
+					else {
+						stack[stackSize++] = { n.left, hits };
+						stack[stackSize++] = { n.right, hits };
+					}
+				}
+			}
+
+			T& GetObject(int proxy) {
+				return nodes[proxy].object;
+			}
+
+			const T& GetObject(int proxy) const {
+				return nodes[proxy].object;
+			}
+
+			int GetProxyCount() const {
+				return proxyCount;
+			}
+
+			int GetHeight() const {
+				return root == NullNode ? 0 : nodes[root].height;
+			}
+
+		protected:
+			static const int MaxStackDepth = 256;
+
+			static bool Overlaps(const Vector3& minA, const Vector3& maxA, const Vector3& minB, const Vector3& maxB) {
+				return	minA.x <= maxB.x && maxA.x >= minB.x &&
+						minA.y <= maxB.y && maxA.y >= minB.y &&
+						minA.z <= maxB.z && maxA.z >= minB.z;
+			}
+
+			/*
+			Axis aligned directions would give us infinities (and NaNs, when
+			multiplied by zero), so they get a huge but finite inverse instead.
+			*/
+			static Vector3 InverseDirection(const Vector3& direction) {
+				Vector3 inv;
+				for (int i = 0; i < 3; ++i) {
+					inv[i] = (std::abs(direction[i]) > 1e-20f) ? 1.0f / direction[i] : std::copysign(1e20f, direction[i]);
+				}
+				return inv;
+			}
+
+			//Slab test - entry is how far along the ray it enters the box, or 0 if it starts inside
+			static bool RayHitsBox(const Vector3& boxMin, const Vector3& boxMax, const Vector3& origin, const Vector3& invDir, float maxDistance, float& entry) {
+				float tNear = 0.0f;
+				float tFar	= maxDistance;
+				for (int i = 0; i < 3; ++i) {
+					float t0 = (boxMin[i] - origin[i]) * invDir[i];
+					float t1 = (boxMax[i] - origin[i]) * invDir[i];
+					tNear	= std::max(tNear, std::min(t0, t1));
+					tFar	= std::min(tFar, std::max(t0, t1));
+				}
+				entry = tNear;
+				return tNear <= tFar;
+			}
+
+			//Zero if the point is inside the box
+			static float BoxDistance(const Vector3& boxMin, const Vector3& boxMax, const Vector3& point) {
+				Vector3 outside = Vector::Max(boxMin - point, Vector::Max(point - boxMax, Vector3()));
+				return Vector::Length(outside);
+			}
+
+			static float SurfaceArea(const Vector3& boxMin, const Vector3& boxMax) {
+				Vector3 d = boxMax - boxMin;
+				return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+			}
+
+			int AllocateNode() {
+				int index;
+				if (freeList != NullNode) {
+					index		= freeList;
+					freeList	= nodes[index].parent;
+				}
+				else {
+					index = (int)nodes.size();
+					nodes.emplace_back();
+				}
+				AABBTreeNode<T>& n = nodes[index];
+				n.parent	= NullNode;
+				n.left		= NullNode;
+				n.right		= NullNode;
+				n.height	= 0;
+				n.object	= T();
+				return index;
+			}
+
+			void FreeNode(int index) {
+				nodes[index].parent = freeList;
+				nodes[index].height = -1;
+				freeList = index;
+			}
+
+			void SetFromChildren(int index) {
+				AABBTreeNode<T>& n			= nodes[index];
+				const AABBTreeNode<T>& l	= nodes[n.left];
+				const AABBTreeNode<T>& r	= nodes[n.right];
+
+				n.boxMin = Vector::Min(l.boxMin, r.boxMin);
+				n.boxMax = Vector::Max(l.boxMax, r.boxMax);
+				n.height = 1 + std::max(l.height, r.height);
+			}
+
+			void InsertLeaf(int leaf) {
+				if (root == NullNode) {
+					root = leaf;
+					nodes[root].parent = NullNode;
+					return;
+				}
+				Vector3 leafMin = nodes[leaf].boxMin;
+				Vector3 leafMax = nodes[leaf].boxMax;
+
+				//Walk down the tree, picking the cheapest sibling for the new leaf
+				int index = root;
+				while (!nodes[index].IsLeaf()) {
+					const AABBTreeNode<T>& n = nodes[index];
+
+					float area			= SurfaceArea(n.boxMin, n.boxMax);
+					float combinedArea	= SurfaceArea(Vector::Min(n.boxMin, leafMin), Vector::Max(n.boxMax, leafMax));
+
+					float cost				= 2.0f * combinedArea;			//Cost of pairing with this node
+					float inheritanceCost	= 2.0f * (combinedArea - area);	//Cost of pushing the leaf further down
+
+					float costLeft	= DescendCost(n.left, leafMin, leafMax)  + inheritanceCost;
+					float costRight	= DescendCost(n.right, leafMin, leafMax) + inheritanceCost;
+
+					if (cost < costLeft && cost < costRight) {
+						break;
+					}
+					index = (costLeft < costRight) ? n.left : n.right;
+				}
+				int sibling		= index;
+				int oldParent	= nodes[sibling].parent;
+				int newParent	= AllocateNode();
+
+				nodes[newParent].parent = oldParent;
+				nodes[newParent].left	= sibling;
+				nodes[newParent].right	= leaf;
+				nodes[sibling].parent	= newParent;
+				nodes[leaf].parent		= newParent;
+
+				if (oldParent == NullNode) {
+					root = newParent;
+				}
+				else if (nodes[oldParent].left == sibling) {
+					nodes[oldParent].left = newParent;
+				}
+				else {
+					nodes[oldParent].right = newParent;
+				}
+				FixUpwards(newParent);
+			}
+
+			float DescendCost(int index, const Vector3& leafMin, const Vector3& leafMax) const {
+				const AABBTreeNode<T>& n = nodes[index];
+				float combinedArea = SurfaceArea(Vector::Min(n.boxMin, leafMin), Vector::Max(n.boxMax, leafMax));
+				if (n.IsLeaf()) {
+					return combinedArea;
+				}
+				return combinedArea - SurfaceArea(n.boxMin, n.boxMax);
+			}
+
+			void RemoveLeaf(int leaf) {
+				if (leaf == root) {
+					root = NullNode;
+					return;
+				}
+				int parent		= nodes[leaf].parent;
+				int grandParent = nodes[parent].parent;
+				int sibling		= (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+
+				if (grandParent == NullNode) {
+					root = sibling;
+					nodes[sibling].parent = NullNode;
+					FreeNode(parent);
+					return;
+				}
+				if (nodes[grandParent].left == parent) {
+					nodes[grandParent].left = sibling;
+				}
+				else {
+					nodes[grandParent].right = sibling;
+				}
+				nodes[sibling].parent = grandParent;
+				FreeNode(parent);
+				FixUpwards(grandParent);
+			}
+
+			void FixUpwards(int index) {
+				while (index != NullNode) {
+					index = Balance(index);
+					SetFromChildren(index);
+					index = nodes[index].parent;
+				}
+			}
+
+			/*
+			If one child of 'a' is more than one level taller than the other, we
+			rotate that child up to take a's place, handing one of its own
+			children down to 'a'. Returns the node now at a's old position.
+			*/
+			int Balance(int a) {
+				AABBTreeNode<T>& nodeA = nodes[a];
+				if (nodeA.IsLeaf() || nodeA.height < 2) {
+					return a;
+				}
+				int b = nodeA.left;
+				int c = nodeA.right;
+				int balance = nodes[c].height - nodes[b].height;
+
+				if (balance > 1) {
+					return Rotate(a, c, false);
+				}
+				if (balance < -1) {
+					return Rotate(a, b, true);
+				}
+				return a;
+			}
+
+			int Rotate(int a, int up, bool upIsLeft) {
+				AABBTreeNode<T>& nodeA	= nodes[a];
+				AABBTreeNode<T>& nodeUp	= nodes[up];
+
+				int f = nodeUp.left;
+				int g = nodeUp.right;
+
+				nodeUp.left		= a;
+				nodeUp.parent	= nodeA.parent;
+				nodeA.parent	= up;
+
+				if (nodeUp.parent == NullNode) {
+					root = up;
+				}
+				else if (nodes[nodeUp.parent].left == a) {
+					nodes[nodeUp.parent].left = up;
+				}
+				else {
+					nodes[nodeUp.parent].right = up;
+				}
+				//The taller grandchild stays with 'up', the other moves down to 'a'
+				int keep = f;
+				int give = g;
+				if (nodes[g].height > nodes[f].height) {
+					keep = g;
+					give = f;
+				}
+				nodeUp.right = keep;
+				if (upIsLeft) {
+					nodeA.left = give;
+				}
+				else {
+					nodeA.right = give;
+				}
+				nodes[give].parent = a;
+
+				SetFromChildren(a);
+				SetFromChildren(up);
+				return up;
+			}
+
+			std::vector<AABBTreeNode<T>> nodes;
+			int		root;
+			int		freeList;
+			int		proxyCount;
+			float	margin;
+		};
+	}
+}
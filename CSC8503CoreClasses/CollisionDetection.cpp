@@ -3,10 +3,16 @@
 #include "AABBVolume.h"
 #include "OBBVolume.h"
 #include "SphereVolume.h"
+#include "GJK.h"
 #include "Window.h"
 #include "Maths.h"
 #include "Debug.h"
 
+#include <array>
+#include <bit>
+#include <tuple>
+#include <utility>
+
 using namespace NCL;
 
 bool CollisionDetection::RayPlaneIntersection(const Ray&r, const Plane&p, RayCollision& collisions) {
@@ -43,6 +49,8 @@ bool CollisionDetection::RayIntersection(const Ray& r,GameObject& object, RayCol
 		case VolumeType::Sphere:	hasCollided = RaySphereIntersection(r, worldTransform, (const SphereVolume&)*volume, collision); break;
 
 		case VolumeType::Capsule:	hasCollided = RayCapsuleIntersection(r, worldTransform, (const CapsuleVolume&)*volume, collision); break;
+		case VolumeType::ConvexHull:hasCollided = RayConvexHullIntersection(r, worldTransform, (const ConvexHullVolume&)*volume, collision); break;
+		default: break;
 	}
 
 	return hasCollided;
@@ -57,10 +65,10 @@ bool CollisionDetection::RayBoxIntersection(const Ray&r, const Vector3& boxPos,
 
 	for (int i = 0; i < 3; ++i) {
 		if (rayDir[i] > 0) {
-			tVals[i] = (boxMin[i] - rayPos[i] / rayDir[i]);
+			tVals[i] = (boxMin[i] - rayPos[i]) / rayDir[i];
 		}
 		else if (rayDir[i] < 0) {
-			tVals[i] = (boxMax[i] - rayPos[i] / rayDir[i]);
+			tVals[i] = (boxMax[i] - rayPos[i]) / rayDir[i];
 		}
 	}
 
@@ -131,76 +139,131 @@ bool CollisionDetection::RayCapsuleIntersection(const Ray& r, const Transform& w
 	return false;
 }
 
-bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
-	const CollisionVolume* volA = a->GetBoundingVolume();
-	const CollisionVolume* volB = b->GetBoundingVolume();
-
-	if (!volA || !volB) {
+/*
+Nothing on the ray can be closer to a convex volume than the point we're
+at now is, so we can always step that far along the ray without passing
+through the hull - each step creeps closer, until we're touching it, or
+have come out the far side of its bounding sphere without hitting it.
+As with boxes, a ray that starts inside the hull doesn't hit it.
+*/
+bool CollisionDetection::RayConvexHullIntersection(const Ray& r, const Transform& worldTransform, const ConvexHullVolume& volume, RayCollision& collision) {
+	const int	maxIterations	= 64;
+	const float tolerance		= 0.0001f;
+
+	Vector3		position	= worldTransform.GetPosition();
+	Quaternion	orientation = worldTransform.GetOrientation();
+	Vector3		rayPos		= r.GetPosition();
+	Vector3		rayDir		= Vector::Normalise(r.GetDirection());
+
+	//Only the part of the ray inside the hull's bounding sphere needs searching
+	Vector3 toCentre	= position - rayPos;
+	float	centreProj	= Vector::Dot(toCentre, rayDir);
+	float	offsetSq	= volume.GetRadius() * volume.GetRadius() - (Vector::Dot(toCentre, toCentre) - centreProj * centreProj);
+	if (offsetSq < 0.0f) {
 		return false;
 	}
-
-	collisionInfo.a = a;
-	collisionInfo.b = b;
-
-	Transform& transformA = a->GetTransform();
-	Transform& transformB = b->GetTransform();
-
-	VolumeType pairType = (VolumeType)((int)volA->type | (int)volB->type);
-
-	//Two AABBs
-	if (pairType == VolumeType::AABB) {
-		return AABBIntersection((AABBVolume&)*volA, transformA, (AABBVolume&)*volB, transformB, collisionInfo);
-	}
-	//Two Spheres
-	if (pairType == VolumeType::Sphere) {
-		return SphereIntersection((SphereVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
-	}
-	//Two OBBs
-	if (pairType == VolumeType::OBB) {
-		return OBBIntersection((OBBVolume&)*volA, transformA, (OBBVolume&)*volB, transformB, collisionInfo);
+	float offset	= std::sqrt(offsetSq);
+	float t			= std::max(centreProj - offset, 0.0f);
+	float exitT		= centreProj + offset;
+
+	for (int i = 0; i < maxIterations && t <= exitT; ++i) {
+		Vector3 point		= rayPos + rayDir * t;
+		float	distance	= GJK::PointDistance(point, volume, position, orientation);
+		if (distance < tolerance) {
+			if (t == 0.0f) {
+				return false;
+			}
+			collision.collidedAt	= point;
+			collision.rayDistance	= t;
+			return true;
+		}
+		t += distance;
 	}
-	//Two Capsules
+	return false;
+}
 
-	//AABB vs Sphere pairs
-	if (volA->type == VolumeType::AABB && volB->type == VolumeType::Sphere) {
-		return AABBSphereIntersection((AABBVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
-	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::AABB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return AABBSphereIntersection((AABBVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+/*
+Every pair of volume types gets its own entry in a table of intersection
+tests, built at compile time from whichever tests exist. A pair that only
+has a test written the other way around (sphere vs AABB, say) gets an entry
+that calls that test with the volumes swapped, and then flips the contacts
+back around so they still go from a to b. Convex pairs without any test of
+their own fall back to GJK, and anything else never collides.
+*/
+namespace {
+	//Indexed by the bit each VolumeType sets - Mesh and Compound volumes have no class of their own
+	using VolumeClasses = std::tuple<AABBVolume, OBBVolume, SphereVolume, CollisionVolume, CapsuleVolume, CollisionVolume, ConvexHullVolume>;
+	constexpr size_t VolumeClassCount = std::tuple_size_v<VolumeClasses>;
+
+	template<typename A, typename B> struct DirectTest					{ static constexpr std::nullptr_t test = nullptr; };
+	template<> struct DirectTest<AABBVolume, AABBVolume>				{ static constexpr auto test = &CollisionDetection::AABBIntersection; };
+	template<> struct DirectTest<SphereVolume, SphereVolume>			{ static constexpr auto test = &CollisionDetection::SphereIntersection; };
+	template<> struct DirectTest<OBBVolume, OBBVolume>					{ static constexpr auto test = &CollisionDetection::OBBIntersection; };
+	template<> struct DirectTest<AABBVolume, OBBVolume>					{ static constexpr auto test = &CollisionDetection::AABBOBBIntersection; };
+	template<> struct DirectTest<AABBVolume, SphereVolume>				{ static constexpr auto test = &CollisionDetection::AABBSphereIntersection; };
+	template<> struct DirectTest<OBBVolume, SphereVolume>				{ static constexpr auto test = &CollisionDetection::OBBSphereIntersection; };
+	template<> struct DirectTest<CapsuleVolume, SphereVolume>			{ static constexpr auto test = &CollisionDetection::SphereCapsuleIntersection; };
+	template<> struct DirectTest<CapsuleVolume, AABBVolume>				{ static constexpr auto test = &CollisionDetection::AABBCapsuleIntersection; };
+
+	template<typename A, typename B>
+	constexpr bool HasDirectTest = !std::is_same_v<decltype(DirectTest<A, B>::test), const std::nullptr_t>;
+
+	void FlipContacts(CollisionDetection::CollisionInfo& collisionInfo) {
+		for (int i = 0; i < collisionInfo.pointCount; ++i) {
+			CollisionDetection::ContactPoint& p = collisionInfo.points[i];
+			std::swap(p.localA, p.localB);
+			p.normal = -p.normal;
+		}
 	}
 
-	//OBB vs sphere pairs
-	if (volA->type == VolumeType::OBB && volB->type == VolumeType::Sphere) {
-		return OBBSphereIntersection((OBBVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
-	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::OBB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return OBBSphereIntersection((OBBVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+	template<typename A, typename B>
+	bool PairIntersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+		const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionDetection::CollisionInfo& collisionInfo) {
+		if constexpr (HasDirectTest<A, B>) {
+			return DirectTest<A, B>::test(static_cast<const A&>(volumeA), worldTransformA, static_cast<const B&>(volumeB), worldTransformB, collisionInfo);
+		}
+		else if constexpr (HasDirectTest<B, A>) {
+			bool hit = DirectTest<B, A>::test(static_cast<const B&>(volumeB), worldTransformB, static_cast<const A&>(volumeA), worldTransformA, collisionInfo);
+			FlipContacts(collisionInfo);
+			return hit;
+		}
+		else if constexpr (!std::is_same_v<A, CollisionVolume> && !std::is_same_v<B, CollisionVolume>) {
+			return GJK::Intersection(volumeA, worldTransformA, volumeB, worldTransformB, collisionInfo);
+		}
+		return false;
 	}
 
-	//Capsule vs other interactions
-	if (volA->type == VolumeType::Capsule && volB->type == VolumeType::Sphere) {
-		return SphereCapsuleIntersection((CapsuleVolume&)*volA, transformA, (SphereVolume&)*volB, transformB, collisionInfo);
-	}
-	if (volA->type == VolumeType::Sphere && volB->type == VolumeType::Capsule) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return SphereCapsuleIntersection((CapsuleVolume&)*volB, transformB, (SphereVolume&)*volA, transformA, collisionInfo);
+	template<size_t... I>
+	constexpr std::array<CollisionDetection::IntersectionTest, sizeof...(I)> MakeIntersectionTable(std::index_sequence<I...>) {
+		return { &PairIntersection<std::tuple_element_t<I / VolumeClassCount, VolumeClasses>, std::tuple_element_t<I % VolumeClassCount, VolumeClasses>>... };
 	}
 
-	if (volA->type == VolumeType::Capsule && volB->type == VolumeType::AABB) {
-		return AABBCapsuleIntersection((CapsuleVolume&)*volA, transformA, (AABBVolume&)*volB, transformB, collisionInfo);
+	constexpr auto intersectionTable = MakeIntersectionTable(std::make_index_sequence<VolumeClassCount * VolumeClassCount>());
+}
+
+CollisionDetection::IntersectionTest CollisionDetection::GetIntersectionTest(VolumeType a, VolumeType b) {
+	size_t indexA = std::countr_zero((unsigned int)a);
+	size_t indexB = std::countr_zero((unsigned int)b);
+	if (indexA >= VolumeClassCount || indexB >= VolumeClassCount) {
+		return nullptr;
 	}
-	if (volB->type == VolumeType::Capsule && volA->type == VolumeType::AABB) {
-		collisionInfo.a = b;
-		collisionInfo.b = a;
-		return AABBCapsuleIntersection((CapsuleVolume&)*volB, transformB, (AABBVolume&)*volA, transformA, collisionInfo);
+	return intersectionTable[indexA * VolumeClassCount + indexB];
+}
+
+bool CollisionDetection::ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo) {
+	const CollisionVolume* volA = a->GetBoundingVolume();
+	const CollisionVolume* volB = b->GetBoundingVolume();
+
+	if (!volA || !volB) {
+		return false;
 	}
 
-	return false;
+	collisionInfo.a = a;
+	collisionInfo.b = b;
+	collisionInfo.pointCount = 0;
+
+	IntersectionTest test = GetIntersectionTest(volA->type, volB->type);
+	return test && test(*volA, a->GetTransform(), *volB, b->GetTransform(), collisionInfo);
 }
 
 bool CollisionDetection::AABBTest(const Vector3& posA, const Vector3& posB, const Vector3& halfSizeA, const Vector3& halfSizeB) {
@@ -265,7 +328,7 @@ bool CollisionDetection::AABBIntersection(const AABBVolume& volumeA, const Trans
 bool CollisionDetection::SphereIntersection(const SphereVolume& volumeA, const Transform& worldTransformA,
 	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
 	float radii = volumeA.GetRadius() + volumeB.GetRadius();
-	Vector3 delta = worldTransformA.GetPosition() - worldTransformB.GetPosition();
+	Vector3 delta = worldTransformB.GetPosition() - worldTransformA.GetPosition(); //Normals point from A to B
 
 	float deltaLength = Vector::Length(delta);
 
@@ -285,7 +348,7 @@ bool CollisionDetection::SphereIntersection(const SphereVolume& volumeA, const T
 bool CollisionDetection::AABBSphereIntersection(const AABBVolume& volumeA, const Transform& worldTransformA,
 	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
 	Vector3 boxSize = volumeA.GetHalfDimensions();
-	Vector3 delta = worldTransformA.GetPosition() - worldTransformB.GetPosition();
+	Vector3 delta = worldTransformB.GetPosition() - worldTransformA.GetPosition(); //Normals point from A to B
 	Vector3 closestPointOnBox = Vector::Clamp(delta, -boxSize, boxSize);
 	Vector3 localPoint = delta - closestPointOnBox;
 	float distance = Vector::Length(localPoint);
@@ -304,26 +367,543 @@ bool CollisionDetection::AABBSphereIntersection(const AABBVolume& volumeA, const
 	return false;
 }
 
+/*
+The sphere's centre is taken into the box's local space, where it's just
+an AABB test again. If the centre has ended up inside the box, we push it
+out through whichever face is nearest.
+*/
 bool  CollisionDetection::OBBSphereIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
 	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	Quaternion	orientation = worldTransformA.GetOrientation();
+	Vector3		boxSize		= volumeA.GetHalfDimensions();
+	Vector3		localCentre = orientation.Conjugate() * (worldTransformB.GetPosition() - worldTransformA.GetPosition());
+	float		radius		= volumeB.GetRadius();
+
+	Vector3 closestPoint	= Vector::Clamp(localCentre, -boxSize, boxSize);
+	Vector3 offset			= localCentre - closestPoint;
+	float	distance		= Vector::Length(offset);
+
+	Vector3 localNormal;
+	float	penetration;
+	if (distance > 0.0f) {
+		if (distance >= radius) {
+			return false;
+		}
+		localNormal = offset / distance;
+		penetration = radius - distance;
+	}
+	else {
+		int		nearestAxis = 0;
+		float	nearestGap	= FLT_MAX;
+		for (int i = 0; i < 3; ++i) {
+			float gap = boxSize[i] - std::abs(localCentre[i]);
+			if (gap < nearestGap) {
+				nearestGap	= gap;
+				nearestAxis = i;
+			}
+		}
+		localNormal[nearestAxis]	= localCentre[nearestAxis] < 0.0f ? -1.0f : 1.0f;
+		closestPoint[nearestAxis]	= boxSize[nearestAxis] * localNormal[nearestAxis];
+		penetration					= radius + nearestGap;
+	}
+	Vector3 normal = orientation * localNormal;
+	Vector3 localA = orientation * closestPoint;
+	Vector3 localB = -normal * radius;
+
+	collisionInfo.AddContactPoint(localA, localB, normal, penetration);
+	return true;
 }
 
 bool CollisionDetection::AABBCapsuleIntersection(
 	const CapsuleVolume& volumeA, const Transform& worldTransformA,
 	const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	return GJK::Intersection(volumeA, worldTransformA, volumeB, worldTransformB, collisionInfo);
 }
 
 bool CollisionDetection::SphereCapsuleIntersection(
 	const CapsuleVolume& volumeA, const Transform& worldTransformA,
 	const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	return GJK::Intersection(volumeA, worldTransformA, volumeB, worldTransformB, collisionInfo);
+}
+
+/*
+Boxes for the separating axis tests - an AABB is just a box whose axes
+are the world axes, whatever its Transform's orientation says.
+*/
+struct OrientedBox {
+	Vector3 position;
+	Vector3 axes[3];
+	Vector3 halfSize;
+
+	OrientedBox(const Vector3& pos, const Quaternion& orientation, const Vector3& size) {
+		position	= pos;
+		halfSize	= size;
+		axes[0]		= orientation * Vector3(1, 0, 0);
+		axes[1]		= orientation * Vector3(0, 1, 0);
+		axes[2]		= orientation * Vector3(0, 0, 1);
+	}
+
+	//How far the box reaches along an axis, either side of its centre
+	float Project(const Vector3& axis) const {
+		return	std::abs(Vector::Dot(axes[0], axis)) * halfSize.x +
+				std::abs(Vector::Dot(axes[1], axis)) * halfSize.y +
+				std::abs(Vector::Dot(axes[2], axis)) * halfSize.z;
+	}
+};
+
+/*
+There are 15 axes that could separate two boxes - the 3 face normals of
+each box (0-2 for A, 3-5 for B), and the 9 cross products of an edge from
+each (6-14). Returns false if the axis is degenerate (parallel edges), else
+fills in how far apart the boxes are along it (negative if overlapping), and
+the axis itself, pointing from A towards B.
+*/
+static bool TestBoxAxis(const OrientedBox& a, const OrientedBox& b, int axis, float& separation, Vector3& normal) {
+	if (axis < 3) {
+		normal = a.axes[axis];
+	}
+	else if (axis < 6) {
+		normal = b.axes[axis - 3];
+	}
+	else {
+		normal = Vector::Cross(a.axes[(axis - 6) / 3], b.axes[(axis - 6) % 3]);
+		float length = Vector::Length(normal);
+		if (length < 0.0001f) {
+			return false;
+		}
+		normal = normal / length;
+	}
+	float distance = Vector::Dot(b.position - a.position, normal);
+	if (distance < 0.0f) {
+		normal		= -normal;
+		distance	= -distance;
+	}
+	separation = distance - (a.Project(normal) + b.Project(normal));
+	return true;
+}
+
+//Sutherland-Hodgman - keeps the part of the polygon where dot(plane, p) <= offset
+static int ClipPolygon(const Vector3* in, int inCount, const Vector3& plane, float offset, Vector3* out) {
+	int outCount = 0;
+	for (int i = 0; i < inCount; ++i) {
+		const Vector3& from = in[i];
+		const Vector3& to	= in[(i + 1) % inCount];
+		float fromDist	= Vector::Dot(plane, from) - offset;
+		float toDist	= Vector::Dot(plane, to) - offset;
+
+		if (fromDist <= 0.0f) {
+			out[outCount++] = from;
+		}
+		if ((fromDist <= 0.0f) != (toDist <= 0.0f)) {
+			out[outCount++] = from + (to - from) * (fromDist / (fromDist - toDist));
+		}
+	}
+	return outCount;
+}
+
+/*
+Clipping can leave us with up to 8 points, but 4 well spread out points
+hold a box up just as well. We keep the deepest, the one furthest from it,
+the one that makes the biggest triangle with those two, and then the one
+making the biggest triangle on the other side of that first edge.
+*/
+static int ReduceManifold(const Vector3* points, const float* depths, int count, const Vector3& normal, int* kept) {
+	if (count <= CollisionDetection::MaxContactPoints) {
+		for (int i = 0; i < count; ++i) {
+			kept[i] = i;
+		}
+		return count;
+	}
+	auto Best = [&](auto&& score) {
+		int		best		= 0;
+		float	bestScore	= -FLT_MAX;
+		for (int i = 0; i < count; ++i) {
+			float s = score(i);
+			if (s > bestScore) {
+				bestScore	= s;
+				best		= i;
+			}
+		}
+		return best;
+	};
+	kept[0] = Best([&](int i) { return depths[i]; });
+	kept[1] = Best([&](int i) { return Vector::LengthSquared(points[i] - points[kept[0]]); });
+
+	Vector3 edge = points[kept[1]] - points[kept[0]];
+	auto Area = [&](int i) { return Vector::Dot(Vector::Cross(edge, points[i] - points[kept[0]]), normal); };
+
+	kept[2] = Best([&](int i) { return std::abs(Area(i)); });
+	float side = Area(kept[2]) > 0.0f ? -1.0f : 1.0f;
+	kept[3] = Best([&](int i) { return Area(i) * side; });
+	return 4;
+}
+
+/*
+When a face decided the separating axis test, the other box's face that
+faces it most directly (the incident face) is clipped against the sides of
+the reference face, and every point left below the reference face becomes
+a contact.
+*/
+static bool BoxFaceContacts(const OrientedBox& a, const OrientedBox& b, int axis, const Vector3& normal, CollisionDetection::CollisionInfo& collisionInfo) {
+	bool referenceIsA				= axis < 3;
+	const OrientedBox& reference	= referenceIsA ? a : b;
+	const OrientedBox& incident		= referenceIsA ? b : a;
+	int refAxis						= referenceIsA ? axis : axis - 3;
+	Vector3 refNormal				= referenceIsA ? normal : -normal; //Out of the reference face, towards the incident box
+
+	int		incAxis = 0;
+	float	mostOpposed = 0.0f;
+	for (int i = 0; i < 3; ++i) {
+		float d = Vector::Dot(incident.axes[i], refNormal);
+		if (std::abs(d) > std::abs(mostOpposed)) {
+			mostOpposed = d;
+			incAxis		= i;
+		}
+	}
+	Vector3 incCentre	= incident.position + incident.axes[incAxis] * (mostOpposed > 0.0f ? -incident.halfSize[incAxis] : incident.halfSize[incAxis]);
+	Vector3 incU		= incident.axes[(incAxis + 1) % 3] * incident.halfSize[(incAxis + 1) % 3];
+	Vector3 incV		= incident.axes[(incAxis + 2) % 3] * incident.halfSize[(incAxis + 2) % 3];
+
+	Vector3 polygon[8] = {
+		incCentre + incU + incV,
+		incCentre - incU + incV,
+		incCentre - incU - incV,
+		incCentre + incU - incV
+	};
+	Vector3 clipped[8];
+	int count = 4;
+
+	for (int i = 1; i < 3; ++i) {
+		const Vector3&	side	= reference.axes[(refAxis + i) % 3];
+		float			extent	= reference.halfSize[(refAxis + i) % 3];
+		float			centre	= Vector::Dot(side, reference.position);
+
+		count = ClipPolygon(polygon, count, side, centre + extent, clipped);
+		count = ClipPolygon(clipped, count, -side, -centre + extent, polygon);
+	}
+
+	float	faceOffset = Vector::Dot(refNormal, reference.position) + reference.halfSize[refAxis];
+	Vector3 points[8];
+	float	depths[8];
+	int		pointCount = 0;
+	for (int i = 0; i < count; ++i) {
+		float depth = faceOffset - Vector::Dot(refNormal, polygon[i]);
+		if (depth >= 0.0f) {
+			points[pointCount]	= polygon[i];
+			depths[pointCount]	= depth;
+			pointCount++;
+		}
+	}
+	if (pointCount == 0) {
+		return false;
+	}
+
+	int kept[CollisionDetection::MaxContactPoints];
+	int keptCount = ReduceManifold(points, depths, pointCount, refNormal, kept);
+	for (int i = 0; i < keptCount; ++i) {
+		Vector3 onIncident	= points[kept[i]];
+		Vector3 onReference = onIncident + refNormal * depths[kept[i]];
+
+		Vector3 onA = referenceIsA ? onReference : onIncident;
+		Vector3 onB = referenceIsA ? onIncident : onReference;
+		collisionInfo.AddContactPoint(onA - a.position, onB - b.position, normal, depths[kept[i]]);
+	}
+	return true;
+}
+
+/*
+When an edge pair decided things, the boxes are touching edge to edge at
+a single point - the closest points between the two edges furthest into
+each other.
+*/
+static bool BoxEdgeContact(const OrientedBox& a, const OrientedBox& b, int axis, const Vector3& normal, float separation, CollisionDetection::CollisionInfo& collisionInfo) {
+	int edgeA = (axis - 6) / 3;
+	int edgeB = (axis - 6) % 3;
+
+	Vector3 pointA = a.position;
+	Vector3 pointB = b.position;
+	for (int i = 0; i < 3; ++i) {
+		if (i != edgeA) {
+			pointA += a.axes[i] * (Vector::Dot(a.axes[i], normal) > 0.0f ? a.halfSize[i] : -a.halfSize[i]);
+		}
+		if (i != edgeB) {
+			pointB += b.axes[i] * (Vector::Dot(b.axes[i], normal) < 0.0f ? b.halfSize[i] : -b.halfSize[i]);
+		}
+	}
+	const Vector3& dirA = a.axes[edgeA];
+	const Vector3& dirB = b.axes[edgeB];
+
+	//Closest points between the two edge lines
+	Vector3 delta		= pointB - pointA;
+	float	dirDot		= Vector::Dot(dirA, dirB);
+	float	denominator = 1.0f - dirDot * dirDot;
+	if (denominator < 0.0001f) {
+		return false;
+	}
+	float alongA = (Vector::Dot(dirA, delta) - dirDot * Vector::Dot(dirB, delta)) / denominator;
+	float alongB = (dirDot * Vector::Dot(dirA, delta) - Vector::Dot(dirB, delta)) / denominator;
+	alongA = std::clamp(alongA, -a.halfSize[edgeA], a.halfSize[edgeA]);
+	alongB = std::clamp(alongB, -b.halfSize[edgeB], b.halfSize[edgeB]);
+
+	Vector3 onA = pointA + dirA * alongA;
+	Vector3 onB = pointB + dirB * alongB;
+	collisionInfo.AddContactPoint(onA - a.position, onB - b.position, normal, -separation);
+	return true;
+}
+
+/*
+Separating axis test between two boxes. If any axis separates them we can
+stop straight away, and as things don't move far between frames, the axis
+that separated them last time is very likely to do so again - so that one
+is tried first. Otherwise, the axis with the least overlap gives us the
+contact normal, with a little bias towards face axes, as face contacts are
+far more stable to rest on than edge ones.
+*/
+static bool BoxIntersection(const OrientedBox& a, const OrientedBox& b, CollisionDetection::CollisionInfo& collisionInfo) {
+	float	separation;
+	Vector3 normal;
+	if (collisionInfo.cachedAxis >= 0 && TestBoxAxis(a, b, collisionInfo.cachedAxis, separation, normal) && separation > 0.0f) {
+		return false;
+	}
+
+	float	bestSeparation[3]	= { -FLT_MAX, -FLT_MAX, -FLT_MAX }; //A faces, B faces, edges
+	int		bestAxis[3]			= { -1, -1, -1 };
+	Vector3 bestNormal[3];
+
+	for (int axis = 0; axis < 15; ++axis) {
+		if (!TestBoxAxis(a, b, axis, separation, normal)) {
+			continue;
+		}
+		if (separation > 0.0f) {
+			collisionInfo.cachedAxis = axis;
+			return false;
+		}
+		int group = axis < 3 ? 0 : (axis < 6 ? 1 : 2);
+		if (separation > bestSeparation[group]) {
+			bestSeparation[group]	= separation;
+			bestAxis[group]			= axis;
+			bestNormal[group]		= normal;
+		}
+	}
+
+	const float relativeTolerance	= 0.95f;
+	const float absoluteTolerance	= 0.01f;
+
+	int group = 0;
+	if (bestSeparation[1] > relativeTolerance * bestSeparation[0] + absoluteTolerance) {
+		group = 1;
+	}
+	if (bestAxis[2] >= 0 && bestSeparation[2] > relativeTolerance * bestSeparation[group] + absoluteTolerance) {
+		group = 2;
+	}
+	collisionInfo.cachedAxis = bestAxis[group];
+
+	if (group == 2) {
+		return BoxEdgeContact(a, b, bestAxis[group], bestNormal[group], bestSeparation[group], collisionInfo);
+	}
+	return BoxFaceContacts(a, b, bestAxis[group], bestNormal[group], collisionInfo);
 }
 
 bool CollisionDetection::OBBIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
 	const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
-	return false;
+	OrientedBox a(worldTransformA.GetPosition(), worldTransformA.GetOrientation(), volumeA.GetHalfDimensions());
+	OrientedBox b(worldTransformB.GetPosition(), worldTransformB.GetOrientation(), volumeB.GetHalfDimensions());
+	return BoxIntersection(a, b, collisionInfo);
+}
+
+bool CollisionDetection::AABBOBBIntersection(const AABBVolume& volumeA, const Transform& worldTransformA,
+	const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo) {
+	OrientedBox a(worldTransformA.GetPosition(), Quaternion(), volumeA.GetHalfDimensions());
+	OrientedBox b(worldTransformB.GetPosition(), worldTransformB.GetOrientation(), volumeB.GetHalfDimensions());
+	return BoxIntersection(a, b, collisionInfo);
+}
+
+//Capsules run along their local y axis, with halfHeight measured out to the tips of their caps
+static float CapsuleSegmentHalfLength(const CapsuleVolume& volume) {
+	return std::max(volume.GetHalfHeight() - volume.GetRadius(), 0.0f);
+}
+
+float CollisionDetection::VolumeInnerRadius(const CollisionVolume& volume) {
+	switch (volume.type) {
+		case VolumeType::AABB:		return Vector::GetMinElement(((const AABBVolume&)volume).GetHalfDimensions());
+		case VolumeType::OBB:		return Vector::GetMinElement(((const OBBVolume&)volume).GetHalfDimensions());
+		case VolumeType::Sphere:	return ((const SphereVolume&)volume).GetRadius();
+		case VolumeType::Capsule:	return ((const CapsuleVolume&)volume).GetRadius();
+		//We don't know where a hull's faces are, so can't say how big a sphere fits inside
+		default:					return 0.0f;
+	}
+}
+
+float CollisionDetection::VolumeOuterRadius(const CollisionVolume& volume) {
+	switch (volume.type) {
+		case VolumeType::AABB:		return Vector::Length(((const AABBVolume&)volume).GetHalfDimensions());
+		case VolumeType::OBB:		return Vector::Length(((const OBBVolume&)volume).GetHalfDimensions());
+		case VolumeType::Sphere:	return ((const SphereVolume&)volume).GetRadius();
+		case VolumeType::Capsule:	return std::max(((const CapsuleVolume&)volume).GetHalfHeight(), ((const CapsuleVolume&)volume).GetRadius());
+		case VolumeType::ConvexHull:return ((const ConvexHullVolume&)volume).GetRadius();
+		default:					return 0.0f;
+	}
+}
+
+//Distance from a point in a box's local space to its surface, negative inside it
+static float PointBoxDistance(const Vector3& localPoint, const Vector3& halfSize) {
+	Vector3 q(std::abs(localPoint.x) - halfSize.x, std::abs(localPoint.y) - halfSize.y, std::abs(localPoint.z) - halfSize.z);
+	float outside	= Vector::Length(Vector::Max(q, Vector3(0, 0, 0)));
+	float inside	= std::min(Vector::GetMaxElement(q), 0.0f);
+	return outside + inside;
+}
+
+float CollisionDetection::PointVolumeDistance(const Vector3& point, const CollisionVolume& volume,
+	const Vector3& position, const Quaternion& orientation) {
+	switch (volume.type) {
+		case VolumeType::AABB: {
+			return PointBoxDistance(point - position, ((const AABBVolume&)volume).GetHalfDimensions());
+		}
+		case VolumeType::OBB: {
+			Vector3 localPoint = orientation.Conjugate() * (point - position);
+			return PointBoxDistance(localPoint, ((const OBBVolume&)volume).GetHalfDimensions());
+		}
+		case VolumeType::Sphere: {
+			return Vector::Length(point - position) - ((const SphereVolume&)volume).GetRadius();
+		}
+		case VolumeType::Capsule: {
+			const CapsuleVolume& capsule = (const CapsuleVolume&)volume;
+			Vector3 axis	= orientation * Vector3(0, 1, 0);
+			float along		= std::clamp(Vector::Dot(point - position, axis), -CapsuleSegmentHalfLength(capsule), CapsuleSegmentHalfLength(capsule));
+			return Vector::Length(point - (position + axis * along)) - capsule.GetRadius();
+		}
+		case VolumeType::ConvexHull: {
+			return GJK::PointDistance(point, volume, position, orientation);
+		}
+		default: {
+			return FLT_MAX;
+		}
+	}
+}
+
+/*
+Sweeping a sphere against a volume is the same as firing a ray at the
+volume grown by the sphere's radius. For boxes we grow them into bigger
+boxes rather than rounding their edges off, so a sphere passing close by a
+corner can be stopped a little early - which is fine, as the discrete tests
+will sort it out from there. We don't count a sphere that starts off inside
+the volume, as the discrete tests already know about that too.
+*/
+bool CollisionDetection::SweptSphereIntersection(float radius, const Vector3& start, const Vector3& end,
+	const CollisionVolume& volume, const Transform& worldTransform, float& timeOfImpact) {
+	Vector3 position	= worldTransform.GetPosition();
+	Vector3 motion		= end - start;
+
+	if (volume.type == VolumeType::Sphere) {
+		float	radii	= radius + ((const SphereVolume&)volume).GetRadius();
+		Vector3 delta	= start - position;
+
+		float a = Vector::Dot(motion, motion);
+		float b = Vector::Dot(delta, motion);
+		float c = Vector::Dot(delta, delta) - radii * radii;
+		if (c <= 0.0f || b >= 0.0f || a == 0.0f) {
+			return false; //Already touching, or not heading towards it
+		}
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f) {
+			return false;
+		}
+		float t = (-b - std::sqrt(discriminant)) / a;
+		if (t > 1.0f) {
+			return false;
+		}
+		timeOfImpact = t;
+		return true;
+	}
+
+	Vector3		halfSize;
+	Quaternion	orientation;
+	if (volume.type == VolumeType::AABB) {
+		halfSize = ((const AABBVolume&)volume).GetHalfDimensions();
+	}
+	else if (volume.type == VolumeType::OBB) {
+		halfSize	= ((const OBBVolume&)volume).GetHalfDimensions();
+		orientation = worldTransform.GetOrientation();
+	}
+	else {
+		return ConservativeAdvancement(radius, start, end, volume, worldTransform, Vector3(), Vector3(), timeOfImpact);
+	}
+	halfSize += Vector3(radius, radius, radius);
+
+	Quaternion	invOrientation	= orientation.Conjugate();
+	Vector3		localStart		= invOrientation * (start - position);
+	Vector3		localMotion		= invOrientation * motion;
+
+	//Slab test - find where the ray enters and leaves each pair of faces
+	float enter = 0.0f;
+	float leave = 1.0f;
+	bool startsInside = true;
+	for (int i = 0; i < 3; ++i) {
+		if (std::abs(localStart[i]) > halfSize[i]) {
+			startsInside = false;
+		}
+		if (localMotion[i] == 0.0f) {
+			if (std::abs(localStart[i]) > halfSize[i]) {
+				return false;
+			}
+			continue;
+		}
+		float t0 = (-halfSize[i] - localStart[i]) / localMotion[i];
+		float t1 = ( halfSize[i] - localStart[i]) / localMotion[i];
+		enter = std::max(enter, std::min(t0, t1));
+		leave = std::min(leave, std::max(t0, t1));
+	}
+	if (startsInside || enter > leave) {
+		return false;
+	}
+	timeOfImpact = enter;
+	return true;
+}
+
+/*
+Conservative advancement steps the sphere forward by as much as it could
+possibly move without touching the volume, given how far away it is now,
+and then checks again. As nothing can close the gap faster than the
+fastest the two could be approaching each other, we can never step past
+the first time of impact - we just creep up on it until we're close enough.
+*/
+bool CollisionDetection::ConservativeAdvancement(float radius, const Vector3& start, const Vector3& end,
+	const CollisionVolume& volume, const Transform& worldTransform,
+	const Vector3& linearMotion, const Vector3& angularMotion, float& timeOfImpact) {
+	const int	maxIterations	= 32;
+	const float tolerance		= 0.001f;
+
+	Vector3		position	= worldTransform.GetPosition();
+	Quaternion	orientation = worldTransform.GetOrientation();
+	Vector3		motion		= end - start;
+
+	//The fastest the gap between them could possibly be closing
+	float maxApproach = Vector::Length(motion - linearMotion) + Vector::Length(angularMotion) * VolumeOuterRadius(volume);
+	if (maxApproach <= 0.0f) {
+		return false;
+	}
+
+	float t = 0.0f;
+	for (int i = 0; i < maxIterations; ++i) {
+		//Same orientation update as the integrator uses
+		Quaternion rotation = orientation + (Quaternion(angularMotion * t * 0.5f, 0.0f) * orientation);
+		rotation.Normalise();
+
+		float distance = PointVolumeDistance(start + motion * t, volume, position + linearMotion * t, rotation) - radius;
+		if (distance < tolerance) {
+			if (i == 0) {
+				return false; //Already touching - the discrete tests will deal with it
+			}
+			timeOfImpact = t;
+			return true;
+		}
+		t += distance / maxApproach;
+		if (t > 1.0f) {
+			return false;
+		}
+	}
+	timeOfImpact = t;
+	return true;
 }
 
 Matrix4 GenerateInverseView(const Camera &c) {
@@ -9,6 +9,7 @@
 #include "OBBVolume.h"
 #include "SphereVolume.h"
 #include "CapsuleVolume.h"
+#include "ConvexHullVolume.h"
 #include "Ray.h"
 
 using NCL::Camera;
@@ -24,18 +25,36 @@ namespace NCL {
 			Vector3 normal;
 			float	penetration;
 		};
+
+		static const int MaxContactPoints = 4;
+
 		struct CollisionInfo {
 			GameObject* a;
 			GameObject* b;		
 			int		framesLeft;
 
-			ContactPoint point;
+			//Faces resting on each other touch in more than one place, so a
+			//collision can have a whole manifold of contact points
+			ContactPoint	points[MaxContactPoints];
+			int				pointCount;
 
-			CollisionInfo() {
+			//The separating axis that decided the last test between this pair,
+			//which is tried first next time (-1 if there isn't one)
+			int				cachedAxis;
 
+			//Likewise, the direction GJK last found between the pair (A to B)
+			Vector3			cachedDirection;
+
+			CollisionInfo() {
+				pointCount = 0;
+				cachedAxis = -1;
 			}
 
 			void AddContactPoint(const Vector3& localA, const Vector3& localB, const Vector3& normal, float p) {
+				if (pointCount == MaxContactPoints) {
+					return;
+				}
+				ContactPoint& point = points[pointCount++];
 				point.localA		= localA;
 				point.localB		= localB;
 				point.normal		= normal;
@@ -61,6 +80,10 @@ namespace NCL {
 			}
 		};
 
+		/*
+		Capsules, convex hulls, and any other pair without a test of its own
+		go through GJK (see GJK.h).
+		*/
 		static bool AABBCapsuleIntersection(
 			const CapsuleVolume& volumeA, const Transform& worldTransformA,
 			const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
@@ -81,6 +104,7 @@ namespace NCL {
 		static bool RayOBBIntersection(const Ray&r, const Transform& worldTransform, const OBBVolume&	volume, RayCollision& collision);
 		static bool RaySphereIntersection(const Ray&r, const Transform& worldTransform, const SphereVolume& volume, RayCollision& collision);
 		static bool RayCapsuleIntersection(const Ray& r, const Transform& worldTransform, const CapsuleVolume& volume, RayCollision& collision);
+		static bool RayConvexHullIntersection(const Ray& r, const Transform& worldTransform, const ConvexHullVolume& volume, RayCollision& collision);
 
 
 		static bool RayPlaneIntersection(const Ray&r, const Plane&p, RayCollision& collisions);
@@ -90,6 +114,11 @@ namespace NCL {
 
 		static bool ObjectIntersection(GameObject* a, GameObject* b, CollisionInfo& collisionInfo);
 
+		//The test ObjectIntersection uses for a pair of volume types, or nullptr if they can never collide
+		using IntersectionTest = bool(*)(const CollisionVolume& volumeA, const Transform& worldTransformA,
+			const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+		static IntersectionTest GetIntersectionTest(VolumeType a, VolumeType b);
+
 
 		static bool AABBIntersection(	const AABBVolume& volumeA, const Transform& worldTransformA,
 										const AABBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
@@ -103,10 +132,36 @@ namespace NCL {
 		static bool OBBIntersection(	const OBBVolume& volumeA, const Transform& worldTransformA,
 										const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
 
+		//AABBs can be tested against OBBs as boxes that happen not to be rotated
+		static bool AABBOBBIntersection(const AABBVolume& volumeA, const Transform& worldTransformA,
+										const OBBVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
+
 
 		static bool OBBSphereIntersection(const OBBVolume& volumeA, const Transform& worldTransformA,
 			const SphereVolume& volumeB, const Transform& worldTransformB, CollisionInfo& collisionInfo);
 
+		/*
+		Continuous collision detection. A fast moving object is swept as the
+		largest sphere that fits inside of its volume - if that can't get
+		through something, then neither can the object itself. Times of
+		impact are given as a fraction of the way from start to end.
+		*/
+		static float VolumeInnerRadius(const CollisionVolume& volume);
+		static float VolumeOuterRadius(const CollisionVolume& volume);
+
+		//Signed distance from a point to the surface of a volume, negative inside it
+		static float PointVolumeDistance(const Vector3& point, const CollisionVolume& volume,
+			const Vector3& position, const Quaternion& orientation);
+
+		//A sphere moving in a straight line against a volume that isn't moving
+		static bool SweptSphereIntersection(float radius, const Vector3& start, const Vector3& end,
+			const CollisionVolume& volume, const Transform& worldTransform, float& timeOfImpact);
+
+		//As above, but the volume may also be moving and rotating, by the given amounts over the sweep
+		static bool ConservativeAdvancement(float radius, const Vector3& start, const Vector3& end,
+			const CollisionVolume& volume, const Transform& worldTransform,
+			const Vector3& linearMotion, const Vector3& angularMotion, float& timeOfImpact);
+
 
 		static Vector3 Unproject(const Vector3& screenPos, const PerspectiveCamera& cam);
 
@@ -0,0 +1,118 @@
+#include "CollisionPairCache.h"
+#include "GameObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+static const int EmptySlot = -1;
+
+static size_t HashKey(uint64_t key) {
+	//64 bit finaliser from MurmurHash3 - consecutive world IDs would
+	//otherwise all land in neighbouring slots
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return (size_t)key;
+}
+
+CollisionPairCache::CollisionPairCache(size_t initialCapacity) {
+	size_t capacity = 16;
+	while (capacity < initialCapacity * 2) {
+		capacity *= 2;
+	}
+	table.resize(capacity, { 0, EmptySlot });
+	mask = capacity - 1;
+	entries.reserve(initialCapacity);
+}
+
+CollisionPairCache::~CollisionPairCache() {
+}
+
+uint64_t CollisionPairCache::PairKey(const GameObject* a, const GameObject* b) {
+	uint32_t idA = (uint32_t)a->GetWorldID();
+	uint32_t idB = (uint32_t)b->GetWorldID();
+	if (idA > idB) {
+		std::swap(idA, idB);
+	}
+	return ((uint64_t)idA << 32) | idB;
+}
+
+size_t CollisionPairCache::FindSlot(uint64_t key) const {
+	size_t slot = HashKey(key) & mask;
+	while (table[slot].index != EmptySlot && table[slot].key != key) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+CollisionPairCache::Entry* CollisionPairCache::Find(const GameObject* a, const GameObject* b) {
+	const Slot& s = table[FindSlot(PairKey(a, b))];
+	if (s.index == EmptySlot) {
+		return nullptr;
+	}
+	return &entries[s.index];
+}
+
+CollisionPairCache::Entry& CollisionPairCache::Add(const CollisionDetection::CollisionInfo& info, bool& isNew) {
+	uint64_t key	= PairKey(info.a, info.b);
+	size_t slot		= FindSlot(key);
+
+	if (table[slot].index != EmptySlot) {
+		isNew = false;
+		return entries[table[slot].index];
+	}
+	isNew = true;
+	//Keep the table at most half full, so probe chains stay short
+	if ((entries.size() + 1) * 2 > table.size()) {
+		Grow();
+		slot = FindSlot(key);
+	}
+	table[slot] = { key, (int)entries.size() };
+	entries.push_back({ key, info, CollisionPairState::Begin });
+	entries.back().impulseCount = 0;
+	return entries.back();
+}
+
+void CollisionPairCache::RemoveAt(size_t index) {
+	size_t slot = FindSlot(entries[index].key);
+
+	//Move the last entry into the gap, and point its slot at the new position
+	size_t lastIndex = entries.size() - 1;
+	if (index != lastIndex) {
+		entries[index] = entries[lastIndex];
+		table[FindSlot(entries[index].key)].index = (int)index;
+	}
+	entries.pop_back();
+
+	//Backward shift deletion - pull later entries of the probe chain into the
+	//gap, so that we never need tombstones
+	table[slot].index = EmptySlot;
+	size_t next = (slot + 1) & mask;
+	while (table[next].index != EmptySlot) {
+		size_t ideal = HashKey(table[next].key) & mask;
+		//Can the entry in 'next' legally live in 'slot'?
+		bool canMove = (next > slot) ? (ideal <= slot || ideal > next) : (ideal <= slot && ideal > next);
+		if (canMove) {
+			table[slot] = table[next];
+			table[next].index = EmptySlot;
+			slot = next;
+		}
+		next = (next + 1) & mask;
+	}
+}
+
+void CollisionPairCache::Clear() {
+	entries.clear();
+	std::fill(table.begin(), table.end(), Slot{ 0, EmptySlot });
+}
+
+void CollisionPairCache::Grow() {
+	table.assign(table.size() * 2, { 0, EmptySlot });
+	mask = table.size() - 1;
+
+	for (size_t i = 0; i < entries.size(); ++i) {
+		table[FindSlot(entries[i].key)] = { entries[i].key, (int)i };
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		enum class CollisionPairState {
+			Begin,		//Found this step, objects haven't been told yet
+			Persist		//Objects have been told, still touching (or recently were)
+		};
+
+		/*
+		Stores collision pairs in one contiguous array, with an open addressing
+		hash table (linear probing) mapping a pair's key to its array slot. Keys
+		are built from the objects' world IDs rather than their addresses, so
+		the same pair always hashes the same way, whatever order the objects were
+		allocated in.
+
+		Removing a pair moves the last pair into its place, so indices into the
+		cache are only stable until the next removal.
+		*/
+		class CollisionPairCache {
+		public:
+			struct Entry {
+				uint64_t							key;
+				CollisionDetection::CollisionInfo	info;
+				CollisionPairState					state;
+
+				//Impulses the contact solver ended the last step with, one per
+				//contact point, so that it can start the next one from them
+				//(warm starting). Points are matched up by where they are on A.
+				struct PointImpulse {
+					Vector3	localA;
+					float	normal;
+					float	tangent[2];
+				};
+				PointImpulse						impulses[CollisionDetection::MaxContactPoints];
+				int									impulseCount;
+			};
+
+			CollisionPairCache(size_t initialCapacity = 64);
+			~CollisionPairCache();
+
+			static uint64_t PairKey(const GameObject* a, const GameObject* b);
+
+			Entry* Find(const GameObject* a, const GameObject* b);
+
+			//Returns the existing entry for this pair if there is one, or a new
+			//Begin entry holding a copy of info if not.
+			Entry& Add(const CollisionDetection::CollisionInfo& info, bool& isNew);
+
+			void RemoveAt(size_t index);
+			void Clear();
+
+			size_t Size() const {
+				return entries.size();
+			}
+
+			Entry& operator[](size_t index) {
+				return entries[index];
+			}
+
+			size_t IndexOf(const Entry& e) const {
+				return &e - entries.data();
+			}
+
+			std::vector<Entry>::iterator begin() {
+				return entries.begin();
+			}
+
+			std::vector<Entry>::iterator end() {
+				return entries.end();
+			}
+
+		protected:
+			struct Slot {
+				uint64_t	key;
+				int			index;	//-1 for an empty slot
+			};
+
+			size_t	FindSlot(uint64_t key) const;
+			void	Grow();
+
+			std::vector<Entry>	entries;
+			std::vector<Slot>	table;
+			size_t				mask;
+		};
+	}
+}
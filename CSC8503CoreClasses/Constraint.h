@@ -2,12 +2,24 @@
 
 namespace NCL {
 	namespace CSC8503 {
+		class GameObject;
+
 		class Constraint	{
 		public:
 			Constraint() {}
 			virtual ~Constraint() {}
 
 			virtual void UpdateConstraint(float dt) = 0;
+
+			//The objects this constraint ties together, so that the physics
+			//system knows to wake or sleep them as one
+			virtual GameObject* GetObjectA() const {
+				return nullptr;
+			}
+
+			virtual GameObject* GetObjectB() const {
+				return nullptr;
+			}
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "ConvexHullVolume.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace NCL;
+using namespace Maths;
+
+ConvexHullVolume::ConvexHullVolume(const Rendering::Mesh& mesh, const Vector3& scale) {
+	AddPoints(mesh.GetPositionData(), scale);
+}
+
+ConvexHullVolume::ConvexHullVolume(const std::vector<Vector3>& positions, const Vector3& scale) {
+	AddPoints(positions, scale);
+}
+
+/*
+Meshes repeat their positions wherever vertices have different normals or
+texture coordinates, so duplicates are thrown away - every point here gets
+looked at on every support query.
+*/
+void ConvexHullVolume::AddPoints(const std::vector<Vector3>& positions, const Vector3& scale) {
+	type		= VolumeType::ConvexHull;
+	radius		= 0.0f;
+	halfSizes	= Vector3();
+
+	for (const Vector3& p : positions) {
+		Vector3 scaled = p * scale;
+		bool duplicate = false;
+		for (const Vector3& existing : points) {
+			if (Vector::LengthSquared(existing - scaled) < 0.000001f) {
+				duplicate = true;
+				break;
+			}
+		}
+		if (duplicate) {
+			continue;
+		}
+		points.push_back(scaled);
+		halfSizes	= Vector::Max(halfSizes, Vector3(std::abs(scaled.x), std::abs(scaled.y), std::abs(scaled.z)));
+		radius		= std::max(radius, Vector::Length(scaled));
+	}
+}
+
+Vector3 ConvexHullVolume::SupportPoint(const Vector3& localDirection) const {
+	Vector3 best;
+	float	bestDot = -FLT_MAX;
+	for (const Vector3& p : points) {
+		float d = Vector::Dot(p, localDirection);
+		if (d > bestDot) {
+			bestDot = d;
+			best	= p;
+		}
+	}
+	return best;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "CollisionVolume.h"
+#include "Vector.h"
+#include <vector>
+
+namespace NCL {
+	namespace Rendering {
+		class Mesh;
+	}
+	/*
+	A convex volume made from the vertex positions of a Mesh. Only the
+	points themselves are kept - the furthest point in any direction is
+	always one of them, and that's all GJK ever asks a volume for - so a
+	mesh that isn't convex will collide as if it were shrink wrapped.
+
+	Positions are in the object's local space, with the scale baked in, as
+	with the half sizes of the box volumes.
+	*/
+	class ConvexHullVolume : public CollisionVolume
+	{
+	public:
+		ConvexHullVolume(const Rendering::Mesh& mesh, const Maths::Vector3& scale = Maths::Vector3(1, 1, 1));
+		ConvexHullVolume(const std::vector<Maths::Vector3>& points, const Maths::Vector3& scale = Maths::Vector3(1, 1, 1));
+		~ConvexHullVolume() {}
+
+		//The furthest point along a local space direction
+		Maths::Vector3 SupportPoint(const Maths::Vector3& localDirection) const;
+
+		const std::vector<Maths::Vector3>& GetPoints() const {
+			return points;
+		}
+
+		//Half size of a box around the origin holding every point
+		Maths::Vector3 GetHalfDimensions() const {
+			return halfSizes;
+		}
+
+		float GetRadius() const {
+			return radius;
+		}
+
+	protected:
+		void AddPoints(const std::vector<Maths::Vector3>& positions, const Maths::Vector3& scale);
+
+		std::vector<Maths::Vector3> points;
+		Maths::Vector3				halfSizes;
+		float						radius;
+	};
+}
@@ -0,0 +1,663 @@
+#include "GJK.h"
+#include "ConvexHullVolume.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+using namespace NCL;
+using namespace CSC8503;
+
+namespace {
+	const int	maxGJKIterations	= 32;
+	const int	maxEPAIterations	= 64;
+	const float gjkTolerance		= 0.0001f;	//Relative improvement in distance we stop at
+	const float epaTolerance		= 0.0001f;	//How close a face has to be to the true surface
+	const float overlapDistance		= 0.0001f;	//Cores closer than this are treated as overlapping
+
+	/*
+	A volume in world space, as a core shape plus a margin around it - for
+	spheres the core is a point, and for capsules a line segment.
+	*/
+	struct ConvexShape {
+		const CollisionVolume*	volume;
+		Vector3					position;
+		Quaternion				orientation;
+		float					margin;
+
+		ConvexShape(const CollisionVolume* v, const Vector3& pos, const Quaternion& rot) {
+			volume		= v;
+			position	= pos;
+			orientation = rot;
+			margin		= 0.0f;
+			if (volume && volume->type == VolumeType::Sphere) {
+				margin = static_cast<const SphereVolume*>(volume)->GetRadius();
+			}
+			else if (volume && volume->type == VolumeType::Capsule) {
+				margin = static_cast<const CapsuleVolume*>(volume)->GetRadius();
+			}
+		}
+
+		Vector3 CoreSupport(const Vector3& direction) const {
+			if (!volume) {
+				return position;
+			}
+			switch (volume->type) {
+				case VolumeType::AABB: {
+					Vector3 half = static_cast<const AABBVolume*>(volume)->GetHalfDimensions();
+					return position + Vector3(direction.x < 0.0f ? -half.x : half.x, direction.y < 0.0f ? -half.y : half.y, direction.z < 0.0f ? -half.z : half.z);
+				}
+				case VolumeType::OBB: {
+					Vector3 half	= static_cast<const OBBVolume*>(volume)->GetHalfDimensions();
+					Vector3 local	= orientation.Conjugate() * direction;
+					return position + orientation * Vector3(local.x < 0.0f ? -half.x : half.x, local.y < 0.0f ? -half.y : half.y, local.z < 0.0f ? -half.z : half.z);
+				}
+				case VolumeType::Capsule: {
+					const CapsuleVolume* capsule = static_cast<const CapsuleVolume*>(volume);
+					Vector3 axis	= orientation * Vector3(0, 1, 0);
+					float	extent	= std::max(capsule->GetHalfHeight() - capsule->GetRadius(), 0.0f);
+					return position + axis * (Vector::Dot(axis, direction) < 0.0f ? -extent : extent);
+				}
+				case VolumeType::ConvexHull: {
+					Vector3 local = orientation.Conjugate() * direction;
+					return position + orientation * static_cast<const ConvexHullVolume*>(volume)->SupportPoint(local);
+				}
+				case VolumeType::Sphere:
+				default:
+					return position; //Spheres are all margin
+			}
+		}
+
+		Vector3 Support(const Vector3& direction, bool withMargin) const {
+			Vector3 p = CoreSupport(direction);
+			if (withMargin && margin > 0.0f) {
+				float length = Vector::Length(direction);
+				if (length > 0.0f) {
+					p += direction * (margin / length);
+				}
+			}
+			return p;
+		}
+	};
+
+	ConvexShape MakeShape(const CollisionVolume& volume, const Transform& transform) {
+		return ConvexShape(&volume, transform.GetPosition(), transform.GetOrientation());
+	}
+
+	//A point of the Minkowski difference A - B, along with where it came from on each volume
+	struct SimplexVertex {
+		Vector3 a;
+		Vector3 b;
+		Vector3 w;
+	};
+
+	struct Simplex {
+		SimplexVertex	v[4];
+		float			u[4];	//Barycentric weights of the closest point
+		int				count;
+
+		Vector3 PointA() const {
+			Vector3 p;
+			for (int i = 0; i < count; ++i) {
+				p += v[i].a * u[i];
+			}
+			return p;
+		}
+
+		Vector3 PointB() const {
+			Vector3 p;
+			for (int i = 0; i < count; ++i) {
+				p += v[i].b * u[i];
+			}
+			return p;
+		}
+
+		void Keep(int i0, float u0) {
+			v[0] = v[i0]; u[0] = u0;
+			count = 1;
+		}
+
+		void Keep(int i0, int i1, float u0, float u1) {
+			SimplexVertex v0 = v[i0], v1 = v[i1];
+			v[0] = v0; u[0] = u0;
+			v[1] = v1; u[1] = u1;
+			count = 2;
+		}
+	};
+
+	SimplexVertex MinkowskiSupport(const ConvexShape& a, const ConvexShape& b, const Vector3& direction, bool withMargin) {
+		SimplexVertex s;
+		s.a = a.Support(direction, withMargin);
+		s.b = b.Support(-direction, withMargin);
+		s.w = s.a - s.b;
+		return s;
+	}
+
+	Vector3 SolveSegment(Simplex& s) {
+		Vector3 ab		= s.v[1].w - s.v[0].w;
+		float	lengthSq = Vector::LengthSquared(ab);
+		float	t		= lengthSq > 0.0f ? -Vector::Dot(s.v[0].w, ab) / lengthSq : 0.0f;
+		if (t <= 0.0f) {
+			s.Keep(0, 1.0f);
+		}
+		else if (t >= 1.0f) {
+			s.Keep(1, 1.0f);
+		}
+		else {
+			s.u[0] = 1.0f - t;
+			s.u[1] = t;
+		}
+		return s.v[0].w * s.u[0] + (s.count > 1 ? s.v[1].w * s.u[1] : Vector3());
+	}
+
+	//Closest point on a triangle to the origin, from Real-Time Collision Detection 5.1.5
+	Vector3 SolveTriangle(Simplex& s) {
+		const Vector3& a = s.v[0].w;
+		const Vector3& b = s.v[1].w;
+		const Vector3& c = s.v[2].w;
+		Vector3 ab = b - a;
+		Vector3 ac = c - a;
+
+		float d1 = Vector::Dot(ab, -a);
+		float d2 = Vector::Dot(ac, -a);
+		if (d1 <= 0.0f && d2 <= 0.0f) {
+			s.Keep(0, 1.0f);
+			return s.v[0].w;
+		}
+		float d3 = Vector::Dot(ab, -b);
+		float d4 = Vector::Dot(ac, -b);
+		if (d3 >= 0.0f && d4 <= d3) {
+			s.Keep(1, 1.0f);
+			return s.v[0].w;
+		}
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+			float t = d1 / (d1 - d3);
+			s.Keep(0, 1, 1.0f - t, t);
+			return s.v[0].w * s.u[0] + s.v[1].w * s.u[1];
+		}
+		float d5 = Vector::Dot(ab, -c);
+		float d6 = Vector::Dot(ac, -c);
+		if (d6 >= 0.0f && d5 <= d6) {
+			s.Keep(2, 1.0f);
+			return s.v[0].w;
+		}
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+			float t = d2 / (d2 - d6);
+			s.Keep(0, 2, 1.0f - t, t);
+			return s.v[0].w * s.u[0] + s.v[1].w * s.u[1];
+		}
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+			float t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			s.Keep(1, 2, 1.0f - t, t);
+			return s.v[0].w * s.u[0] + s.v[1].w * s.u[1];
+		}
+		float total = va + vb + vc;
+		if (total <= 0.0f) {
+			//A flat triangle - the closest point is on its longest edge
+			float ab2 = Vector::LengthSquared(ab);
+			float ac2 = Vector::LengthSquared(ac);
+			float bc2 = Vector::LengthSquared(c - b);
+			if (ab2 >= ac2 && ab2 >= bc2) {
+				s.Keep(0, 1, 0.5f, 0.5f);
+			}
+			else if (ac2 >= bc2) {
+				s.Keep(0, 2, 0.5f, 0.5f);
+			}
+			else {
+				s.Keep(1, 2, 0.5f, 0.5f);
+			}
+			return SolveSegment(s);
+		}
+		s.u[0] = va / total;
+		s.u[1] = vb / total;
+		s.u[2] = vc / total;
+		return a * s.u[0] + b * s.u[1] + c * s.u[2];
+	}
+
+	/*
+	The closest point on a tetrahedron is on whichever of its faces that
+	the origin is in front of is nearest - if the origin isn't in front of
+	any of them, it's inside, and the volumes overlap.
+	*/
+	Vector3 SolveTetrahedron(Simplex& s, bool& containsOrigin) {
+		static const int faces[4][4] = {
+			{ 0, 1, 2, 3 },
+			{ 0, 2, 3, 1 },
+			{ 0, 3, 1, 2 },
+			{ 1, 3, 2, 0 }
+		};
+		Simplex best;
+		Vector3 bestPoint;
+		float	bestDistance	= FLT_MAX;
+		containsOrigin			= true;
+
+		for (const int* f : faces) {
+			const Vector3& a = s.v[f[0]].w;
+			Vector3 normal		= Vector::Cross(s.v[f[1]].w - a, s.v[f[2]].w - a);
+			float	origin		= Vector::Dot(-a, normal);
+			float	opposite	= Vector::Dot(s.v[f[3]].w - a, normal);
+
+			bool flat = std::abs(opposite) < 1e-9f;
+			if (!flat && origin * opposite >= 0.0f) {
+				continue; //The origin is on the same side as the rest of the tetrahedron
+			}
+			containsOrigin = false;
+
+			Simplex face;
+			face.v[0]	= s.v[f[0]];
+			face.v[1]	= s.v[f[1]];
+			face.v[2]	= s.v[f[2]];
+			face.count	= 3;
+			Vector3 p = SolveTriangle(face);
+			float distance = Vector::LengthSquared(p);
+			if (distance < bestDistance) {
+				bestDistance	= distance;
+				bestPoint		= p;
+				best			= face;
+			}
+		}
+		if (containsOrigin) {
+			return Vector3();
+		}
+		s = best;
+		return bestPoint;
+	}
+
+	/*
+	Runs GJK until it either finds the closest point of A - B to the origin
+	(returning true), or finds that the origin is inside it (returning false).
+	*/
+	bool RunGJK(const ConvexShape& a, const ConvexShape& b, const Vector3& direction, bool withMargin, Simplex& s, Vector3& closest) {
+		s.v[0]	= MinkowskiSupport(a, b, direction, withMargin);
+		s.u[0]	= 1.0f;
+		s.count = 1;
+		closest = s.v[0].w;
+
+		for (int i = 0; i < maxGJKIterations; ++i) {
+			float distanceSq = Vector::LengthSquared(closest);
+			if (distanceSq < overlapDistance * overlapDistance) {
+				return false;
+			}
+			SimplexVertex next = MinkowskiSupport(a, b, -closest, withMargin);
+
+			//The new point can't get us any nearer, so we're already there
+			if (distanceSq - Vector::Dot(closest, next.w) <= gjkTolerance * distanceSq) {
+				return true;
+			}
+			for (int j = 0; j < s.count; ++j) {
+				if (Vector::LengthSquared(s.v[j].w - next.w) < 1e-12f) {
+					return true;
+				}
+			}
+			s.v[s.count++] = next;
+
+			bool containsOrigin = false;
+			switch (s.count) {
+				case 2: closest = SolveSegment(s);						break;
+				case 3: closest = SolveTriangle(s);						break;
+				case 4: closest = SolveTetrahedron(s, containsOrigin);	break;
+			}
+			if (containsOrigin) {
+				return false;
+			}
+			if (Vector::LengthSquared(closest) >= distanceSq) {
+				return true; //Rounding has stopped us making progress
+			}
+		}
+		return true;
+	}
+
+	/*
+	GJK can stop with fewer than 4 points if the origin landed exactly on
+	the simplex - EPA needs a proper tetrahedron to start from, so it's
+	filled out with support points in directions that give it some volume.
+	*/
+	bool CompleteTetrahedron(const ConvexShape& a, const ConvexShape& b, Simplex& s) {
+		static const Vector3 axes[6] = {
+			Vector3(1, 0, 0), Vector3(-1, 0, 0), Vector3(0, 1, 0), Vector3(0, -1, 0), Vector3(0, 0, 1), Vector3(0, 0, -1)
+		};
+		if (s.count == 1) {
+			for (const Vector3& axis : axes) {
+				SimplexVertex p = MinkowskiSupport(a, b, axis, true);
+				if (Vector::LengthSquared(p.w - s.v[0].w) > 1e-8f) {
+					s.v[s.count++] = p;
+					break;
+				}
+			}
+		}
+		if (s.count == 2) {
+			Vector3 line = Vector::Normalise(s.v[1].w - s.v[0].w);
+			Vector3 side = Vector::Cross(line, std::abs(line.x) < std::abs(line.y) ? Vector3(1, 0, 0) : Vector3(0, 1, 0));
+			for (int i = 0; i < 6 && s.count == 2; ++i) {
+				SimplexVertex p = MinkowskiSupport(a, b, side, true);
+				if (Vector::LengthSquared(Vector::Cross(p.w - s.v[0].w, line)) > 1e-8f) {
+					s.v[s.count++] = p;
+				}
+				side = Quaternion::AxisAngleToQuaterion(line, 60.0f) * side;
+			}
+		}
+		if (s.count == 3) {
+			Vector3 normal = Vector::Cross(s.v[1].w - s.v[0].w, s.v[2].w - s.v[0].w);
+			for (float sign : { 1.0f, -1.0f }) {
+				SimplexVertex p = MinkowskiSupport(a, b, normal * sign, true);
+				if (std::abs(Vector::Dot(p.w - s.v[0].w, normal)) > 1e-8f) {
+					s.v[s.count++] = p;
+					break;
+				}
+			}
+		}
+		return s.count == 4;
+	}
+
+	struct PolytopeFace {
+		int		v[3];
+		Vector3 normal;
+		float	distance;
+	};
+
+	//A fixed size array, in memory taken from a ScratchAllocator
+	template<class T>
+	class ScratchArray {
+	public:
+		ScratchArray(ScratchAllocator& allocator, size_t capacity) : data(allocator.Allocate<T>(capacity)), count(0), capacity(capacity) {
+		}
+
+		T&			operator[](size_t i)		{ return data[i]; }
+		const T&	operator[](size_t i) const	{ return data[i]; }
+
+		T*		begin()				{ return data; }
+		T*		end()				{ return data + count; }
+		T&		back()				{ return data[count - 1]; }
+		size_t	size() const		{ return count; }
+		bool	empty() const		{ return count == 0; }
+		bool	full() const		{ return count == capacity; }
+
+		void push_back(const T& t)	{ data[count++] = t; }
+		void pop_back()				{ count--; }
+		void clear()				{ count = 0; }
+
+		void erase(T* t) {
+			std::copy(t + 1, end(), t);
+			count--;
+		}
+
+	protected:
+		T*		data;
+		size_t	count;
+		size_t	capacity;
+	};
+
+	bool MakeFace(const ScratchArray<SimplexVertex>& vertices, int i0, int i1, int i2, PolytopeFace& face) {
+		face.v[0] = i0;
+		face.v[1] = i1;
+		face.v[2] = i2;
+		Vector3 normal	= Vector::Cross(vertices[i1].w - vertices[i0].w, vertices[i2].w - vertices[i0].w);
+		float	length	= Vector::Length(normal);
+		if (length < 1e-10f) {
+			return false;
+		}
+		face.normal		= normal / length;
+		face.distance	= Vector::Dot(face.normal, vertices[i0].w);
+		return true;
+	}
+
+	/*
+	Expands the tetrahedron GJK finished with out towards the surface of
+	A - B. Each iteration takes the face nearest the origin, and finds the
+	support point out past it - if that's no further out than the face
+	itself, the face is on the surface and we're done. If not, every face
+	the new point can see is removed, and the hole is filled in with new
+	faces joining the edge of the hole to the new point.
+
+	Lots of pairs can be running through here on different threads at once,
+	so rather than fighting over the heap for the polytope, each thread
+	carves it out of its own scratch memory. A convex polytope has fewer
+	than twice as many faces as vertices, so running out of room for faces
+	should never happen - if it somehow does, we stop expanding there, as if
+	we'd run out of iterations.
+	*/
+	bool RunEPA(const ConvexShape& a, const ConvexShape& b, const Simplex& s, Vector3& normal, float& depth, Vector3& pointA, Vector3& pointB) {
+		const size_t maxVertices	= 4 + maxEPAIterations;
+		const size_t maxFaces		= 4 * maxVertices;
+
+		ScratchScope scratch;
+		ScratchArray<SimplexVertex>			vertices(scratch.GetAllocator(), maxVertices);
+		ScratchArray<PolytopeFace>			faces(scratch.GetAllocator(), maxFaces);
+		ScratchArray<std::pair<int, int>>	edges(scratch.GetAllocator(), 3 * maxFaces); //Every removed face's edges
+		for (int i = 0; i < 4; ++i) {
+			vertices.push_back(s.v[i]);
+		}
+
+		Vector3 centre = (vertices[0].w + vertices[1].w + vertices[2].w + vertices[3].w) * 0.25f;
+		static const int tetrahedron[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+		for (const int* t : tetrahedron) {
+			PolytopeFace face;
+			if (!MakeFace(vertices, t[0], t[1], t[2], face)) {
+				return false;
+			}
+			//Wind every face so its normal points out of the tetrahedron
+			if (Vector::Dot(face.normal, vertices[t[0]].w - centre) < 0.0f) {
+				MakeFace(vertices, t[0], t[2], t[1], face);
+			}
+			faces.push_back(face);
+		}
+
+		PolytopeFace closest = faces[0];
+		for (int iteration = 0; iteration < maxEPAIterations && !faces.empty(); ++iteration) {
+			closest = *std::min_element(faces.begin(), faces.end(),
+				[](const PolytopeFace& x, const PolytopeFace& y) { return x.distance < y.distance; });
+
+			SimplexVertex next = MinkowskiSupport(a, b, closest.normal, true);
+			if (Vector::Dot(next.w, closest.normal) - closest.distance < epaTolerance) {
+				break;
+			}
+			int newIndex = (int)vertices.size();
+			vertices.push_back(next);
+
+			edges.clear();
+			for (size_t i = 0; i < faces.size();) {
+				const PolytopeFace& f = faces[i];
+				if (Vector::Dot(f.normal, next.w - vertices[f.v[0]].w) <= 0.0f) {
+					++i;
+					continue;
+				}
+				//Edges shared by two removed faces are inside the hole, the rest are its rim
+				for (int e = 0; e < 3; ++e) {
+					std::pair<int, int> edge(f.v[e], f.v[(e + 1) % 3]);
+					auto reverse = std::find(edges.begin(), edges.end(), std::make_pair(edge.second, edge.first));
+					if (reverse != edges.end()) {
+						edges.erase(reverse);
+					}
+					else {
+						edges.push_back(edge);
+					}
+				}
+				faces[i] = faces.back();
+				faces.pop_back();
+			}
+			bool outOfFaces = false;
+			for (const std::pair<int, int>& edge : edges) {
+				if (faces.full()) {
+					outOfFaces = true;
+					break;
+				}
+				PolytopeFace face;
+				if (MakeFace(vertices, edge.first, edge.second, newIndex, face)) {
+					faces.push_back(face);
+				}
+			}
+			if (outOfFaces) {
+				break;
+			}
+		}
+
+		//Where the origin projects onto the closest face, as weights of its corners
+		const SimplexVertex& v0 = vertices[closest.v[0]];
+		const SimplexVertex& v1 = vertices[closest.v[1]];
+		const SimplexVertex& v2 = vertices[closest.v[2]];
+		Simplex face;
+		face.v[0]	= v0;
+		face.v[1]	= v1;
+		face.v[2]	= v2;
+		face.count	= 3;
+		SolveTriangle(face);
+
+		normal	= closest.normal;
+		depth	= std::max(closest.distance, 0.0f);
+		pointA	= face.PointA();
+		pointB	= face.PointB();
+		return true;
+	}
+
+	Vector3 StartDirection(const ConvexShape& a, const ConvexShape& b, const Vector3& cached) {
+		if (Vector::LengthSquared(cached) > 0.0f) {
+			return cached;
+		}
+		Vector3 d = b.position - a.position;
+		return Vector::LengthSquared(d) > 0.0f ? d : Vector3(1, 0, 0);
+	}
+
+	/*
+	The full test between two shapes. Returns the contact normal (from A to
+	B) and depth, and the deepest points on each shape.
+	*/
+	bool ShapeIntersection(const ConvexShape& a, const ConvexShape& b, Vector3& direction, Vector3& pointA, Vector3& pointB, float& depth) {
+		Simplex s;
+		Vector3 closest;
+		if (RunGJK(a, b, direction, false, s, closest)) {
+			float distance = Vector::Length(closest);
+			direction = -closest / distance;
+			if (distance >= a.margin + b.margin) {
+				return false;
+			}
+			pointA	= s.PointA() + direction * a.margin;
+			pointB	= s.PointB() - direction * b.margin;
+			depth	= a.margin + b.margin - distance;
+			return true;
+		}
+		//The cores overlap, so we need the margins included to find the way out
+		if (a.margin + b.margin > 0.0f && RunGJK(a, b, direction, true, s, closest)) {
+			return false;
+		}
+		if (!CompleteTetrahedron(a, b, s)) {
+			return false;
+		}
+		return RunEPA(a, b, s, direction, depth, pointA, pointB);
+	}
+
+	/*
+	A capsule lying along whatever it's resting on only touches it at one
+	point as far as GJK is concerned, and would rock back and forth about it.
+	If both ends of its segment are touching, those two are used instead.
+	*/
+	int CapsuleEndContacts(const ConvexShape& capsule, const ConvexShape& other, const Vector3& normal, bool capsuleIsA,
+		Vector3* pointsA, Vector3* pointsB, float* depths) {
+		if (!capsule.volume || capsule.volume->type != VolumeType::Capsule) {
+			return 0;
+		}
+		const CapsuleVolume* volume = static_cast<const CapsuleVolume*>(capsule.volume);
+		Vector3 axis	= capsule.orientation * Vector3(0, 1, 0);
+		float	extent	= std::max(volume->GetHalfHeight() - volume->GetRadius(), 0.0f);
+		if (extent == 0.0f || std::abs(Vector::Dot(axis, normal)) > 0.2f) {
+			return 0;
+		}
+		for (int i = 0; i < 2; ++i) {
+			SphereVolume end(volume->GetRadius());
+			ConvexShape sphere(&end, capsule.position + axis * (i == 0 ? -extent : extent), Quaternion());
+			//The pair keeps its order, so the normal still points from A to B either way
+			Vector3 direction = normal;
+			if (!ShapeIntersection(capsuleIsA ? sphere : other, capsuleIsA ? other : sphere, direction, pointsA[i], pointsB[i], depths[i])) {
+				return 0;
+			}
+		}
+		return 2;
+	}
+}
+
+bool GJK::IsConvex(const CollisionVolume& volume) {
+	switch (volume.type) {
+		case VolumeType::AABB:
+		case VolumeType::OBB:
+		case VolumeType::Sphere:
+		case VolumeType::Capsule:
+		case VolumeType::ConvexHull:
+			return true;
+		default:
+			return false;
+	}
+}
+
+Vector3 GJK::Support(const CollisionVolume& volume, const Transform& worldTransform, const Vector3& direction) {
+	return MakeShape(volume, worldTransform).Support(direction, true);
+}
+
+bool GJK::ClosestPoints(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, Vector3& pointA, Vector3& pointB) {
+	ConvexShape a = MakeShape(volumeA, worldTransformA);
+	ConvexShape b = MakeShape(volumeB, worldTransformB);
+
+	Simplex s;
+	Vector3 closest;
+	if (!RunGJK(a, b, StartDirection(a, b, Vector3()), false, s, closest)) {
+		return false;
+	}
+	float distance = Vector::Length(closest);
+	if (distance <= a.margin + b.margin) {
+		return false;
+	}
+	Vector3 normal = -closest / distance;
+	pointA = s.PointA() + normal * a.margin;
+	pointB = s.PointB() - normal * b.margin;
+	return true;
+}
+
+float GJK::PointDistance(const Vector3& point, const CollisionVolume& volume, const Vector3& position, const Quaternion& orientation) {
+	ConvexShape a(nullptr, point, Quaternion());
+	ConvexShape b(&volume, position, orientation);
+
+	Simplex s;
+	Vector3 closest;
+	if (!RunGJK(a, b, StartDirection(a, b, Vector3()), false, s, closest)) {
+		return 0.0f;
+	}
+	return std::max(Vector::Length(closest) - b.margin, 0.0f);
+}
+
+bool GJK::Intersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+	const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionDetection::CollisionInfo& collisionInfo) {
+	if (!IsConvex(volumeA) || !IsConvex(volumeB)) {
+		return false;
+	}
+	ConvexShape a = MakeShape(volumeA, worldTransformA);
+	ConvexShape b = MakeShape(volumeB, worldTransformB);
+
+	Vector3 normal = StartDirection(a, b, collisionInfo.cachedDirection);
+	Vector3 pointA;
+	Vector3 pointB;
+	float	depth;
+	bool	hit = ShapeIntersection(a, b, normal, pointA, pointB, depth);
+
+	collisionInfo.cachedDirection = normal;
+	if (!hit) {
+		return false;
+	}
+
+	Vector3 endsA[2];
+	Vector3 endsB[2];
+	float	endDepths[2];
+	int		endCount = CapsuleEndContacts(a, b, normal, true, endsA, endsB, endDepths);
+	if (endCount == 0) {
+		endCount = CapsuleEndContacts(b, a, normal, false, endsA, endsB, endDepths);
+	}
+	if (endCount == 0) {
+		collisionInfo.AddContactPoint(pointA - a.position, pointB - b.position, normal, depth);
+		return true;
+	}
+	for (int i = 0; i < endCount; ++i) {
+		collisionInfo.AddContactPoint(endsA[i] - a.position, endsB[i] - b.position, normal, endDepths[i]);
+	}
+	return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "CollisionDetection.h"
+
+namespace NCL {
+	/*
+	Collision detection between any two convex volumes, using nothing more
+	than each volume's support function - the furthest point of the volume
+	in a given direction. GJK walks a simplex through the Minkowski
+	difference of the two volumes towards the origin, which gives us the
+	closest points between them when they're apart. When they overlap, EPA
+	grows that simplex out into a polytope until it finds the face of the
+	Minkowski difference nearest the origin, which gives the contact normal
+	and penetration depth.
+
+	Spheres and capsules are treated as a point or line segment with a
+	radius around it. GJK runs on the point or segment, so that shallow
+	contacts (by far the most common kind) come straight out of the closest
+	points, and EPA only has to step in once the cores themselves overlap.
+
+	The direction between the two volumes is handed back through the
+	CollisionInfo, and used as the starting direction next time, so pairs
+	that have hardly moved since the last step converge almost immediately.
+	*/
+	class GJK {
+	public:
+		//Can this volume be used with GJK at all?
+		static bool IsConvex(const CollisionVolume& volume);
+
+		//The furthest point of a volume along a world space direction
+		static Vector3 Support(const CollisionVolume& volume, const Transform& worldTransform, const Vector3& direction);
+
+		//Closest points between two volumes - returns false if they overlap
+		static bool ClosestPoints(const CollisionVolume& volumeA, const Transform& worldTransformA,
+			const CollisionVolume& volumeB, const Transform& worldTransformB, Vector3& pointA, Vector3& pointB);
+
+		//Distance from a point to a volume, or 0 if it's inside
+		static float PointDistance(const Vector3& point, const CollisionVolume& volume, const Vector3& position, const Quaternion& orientation);
+
+		static bool Intersection(const CollisionVolume& volumeA, const Transform& worldTransformA,
+			const CollisionVolume& volumeB, const Transform& worldTransformB, CollisionDetection::CollisionInfo& collisionInfo);
+	};
+}
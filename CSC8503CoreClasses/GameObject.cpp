@@ -10,6 +10,9 @@ GameObject::GameObject(const std::string& objectName)	{
 	name			= objectName;
 	worldID			= -1;
 	isActive		= true;
+	isTrigger		= false;
+	collisionLayer	= 1;
+	collisionMask	= ~0u;
 	boundingVolume	= nullptr;
 	physicsObject	= nullptr;
 	renderObject	= nullptr;
@@ -48,4 +51,17 @@ void GameObject::UpdateBroadphaseAABB() {
 		Vector3 halfSizes = ((OBBVolume&)*boundingVolume).GetHalfDimensions();
 		broadphaseAABB = mat * halfSizes;
 	}
+	else if (boundingVolume->type == VolumeType::Capsule) {
+		const CapsuleVolume& capsule = (CapsuleVolume&)*boundingVolume;
+		Vector3 axis	= transform.GetOrientation() * Vector3(0, 1, 0);
+		float	extent	= std::max(capsule.GetHalfHeight() - capsule.GetRadius(), 0.0f);
+		float	r		= capsule.GetRadius();
+		broadphaseAABB = Vector3(std::abs(axis.x), std::abs(axis.y), std::abs(axis.z)) * extent + Vector3(r, r, r);
+	}
+	else if (boundingVolume->type == VolumeType::ConvexHull) {
+		Matrix3 mat = Quaternion::RotationMatrix<Matrix3>(transform.GetOrientation());
+		mat = Matrix::Absolute(mat);
+		Vector3 halfSizes = ((ConvexHullVolume&)*boundingVolume).GetHalfDimensions();
+		broadphaseAABB = mat * halfSizes;
+	}
 }
\ No newline at end of file
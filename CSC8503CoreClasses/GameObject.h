@@ -2,6 +2,8 @@
 #include "Transform.h"
 #include "CollisionVolume.h"
 
+#include <cstdint>
+
 using std::vector;
 
 namespace NCL::CSC8503 {
@@ -30,6 +32,10 @@ namespace NCL::CSC8503 {
 			return transform;
 		}
 
+		const Transform& GetTransform() const {
+			return transform;
+		}
+
 		RenderObject* GetRenderObject() const {
 			return renderObject;
 		}
@@ -62,6 +68,44 @@ namespace NCL::CSC8503 {
 			//std::cout << "OnCollisionEnd event occured!\n";
 		}
 
+		/*
+		Every object sits on one or more collision layers, and has a mask of
+		the layers it collides with - a pair is only tested if each object's
+		mask includes the other's layer, and the broadphase throws the rest
+		away before they ever reach the narrowphase. Objects start on layer 1,
+		colliding with everything.
+
+		Triggers still get collision events, but nothing is ever pushed apart
+		from them, so they suit pickups and sensor volumes.
+		*/
+		void SetCollisionLayer(uint32_t layerBits) {
+			collisionLayer = layerBits;
+		}
+
+		uint32_t GetCollisionLayer() const {
+			return collisionLayer;
+		}
+
+		void SetCollisionMask(uint32_t maskBits) {
+			collisionMask = maskBits;
+		}
+
+		uint32_t GetCollisionMask() const {
+			return collisionMask;
+		}
+
+		void SetTrigger(bool state) {
+			isTrigger = state;
+		}
+
+		bool IsTrigger() const {
+			return isTrigger;
+		}
+
+		bool CanCollideWith(const GameObject& other) const {
+			return (collisionLayer & other.collisionMask) != 0 && (other.collisionLayer & collisionMask) != 0;
+		}
+
 		bool GetBroadphaseAABB(Vector3&outsize) const;
 
 		void UpdateBroadphaseAABB();
@@ -83,7 +127,10 @@ namespace NCL::CSC8503 {
 		NetworkObject*		networkObject;
 
 		bool		isActive;
+		bool		isTrigger;
 		int			worldID;
+		uint32_t	collisionLayer;
+		uint32_t	collisionMask;
 		std::string	name;
 
 		Vector3 broadphaseAABB;
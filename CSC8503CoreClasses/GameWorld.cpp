@@ -1,18 +1,24 @@
 #include "GameWorld.h"
 #include "GameObject.h"
+#include "PhysicsObject.h"
 #include "Constraint.h"
 #include "CollisionDetection.h"
 #include "Camera.h"
 
+#include <bit>
 
 using namespace NCL;
 using namespace NCL::CSC8503;
 
-GameWorld::GameWorld()	{
+GameWorld::GameWorld() : staticTree(0.0f), movingTree(0.5f)	{
 	shuffleConstraints	= false;
 	shuffleObjects		= false;
+	shuffleEngine.seed((unsigned int)std::chrono::system_clock::now().time_since_epoch().count());
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+	partitionWorldState = -1;
+	staticTreeDirty		= true;
+	queryTreeWorldState = -1;
 }
 
 GameWorld::~GameWorld()	{
@@ -21,8 +27,17 @@ GameWorld::~GameWorld()	{
 void GameWorld::Clear() {
 	gameObjects.clear();
 	constraints.clear();
+	staticObjects.clear();
+	kinematicObjects.clear();
+	dynamicObjects.clear();
+	staticTree.Clear();
+	movingTree.Clear();
+	movingProxies.clear();
 	worldIDCounter		= 0;
 	worldStateCounter	= 0;
+	partitionWorldState = -1;
+	staticTreeDirty		= true;
+	queryTreeWorldState = -1;
 }
 
 void GameWorld::ClearAndErase() {
@@ -43,6 +58,12 @@ void GameWorld::AddGameObject(GameObject* o) {
 
 void GameWorld::RemoveGameObject(GameObject* o, bool andDelete) {
 	gameObjects.erase(std::remove(gameObjects.begin(), gameObjects.end(), o), gameObjects.end());
+	//A new static object could end up with the same address, and the static
+	//list would look like nothing had changed. Anything else being removed
+	//is caught by the static list itself
+	if (GetBodyType(o) == BodyType::Static) {
+		staticTreeDirty = true;
+	}
 	if (andDelete) {
 		delete o;
 	}
@@ -57,6 +78,135 @@ void GameWorld::GetObjectIterators(
 	last	= gameObjects.end();
 }
 
+void GameWorld::GetObjectIterators(
+	BodyType type,
+	GameObjectIterator& first,
+	GameObjectIterator& last) const {
+
+	const std::vector<GameObject*>* objects = &dynamicObjects;
+	if (type == BodyType::Static) {
+		objects = &staticObjects;
+	}
+	else if (type == BodyType::Kinematic) {
+		objects = &kinematicObjects;
+	}
+	first	= objects->begin();
+	last	= objects->end();
+}
+
+BodyType GameWorld::GetBodyType(const GameObject* o) {
+	const PhysicsObject* phys = o->GetPhysicsObject();
+	if (!phys) {
+		return BodyType::Static;
+	}
+	if (phys->IsKinematic()) {
+		return BodyType::Kinematic;
+	}
+	return phys->GetInverseMass() == 0.0f ? BodyType::Static : BodyType::Dynamic;
+}
+
+/*
+Objects are only sorted when they're used rather than when they're added,
+as objects are often given their mass after being added to the world.
+
+Nothing in the static tree ever moves, so it's built with no fat margin,
+and only rebuilt if the set of static objects actually changes - adding a
+dynamic object to the world leaves it alone.
+*/
+void GameWorld::UpdatePartitions() {
+	if (partitionWorldState == worldStateCounter) {
+		return;
+	}
+	partitionWorldState = worldStateCounter;
+
+	std::vector<GameObject*> oldStatics = std::move(staticObjects);
+	staticObjects.clear();
+	kinematicObjects.clear();
+	dynamicObjects.clear();
+
+	for (GameObject* o : gameObjects) {
+		switch (GetBodyType(o)) {
+			case BodyType::Static:		staticObjects.emplace_back(o);		break;
+			case BodyType::Kinematic:	kinematicObjects.emplace_back(o);	break;
+			case BodyType::Dynamic:		dynamicObjects.emplace_back(o);		break;
+		}
+	}
+	if (!staticTreeDirty && staticObjects == oldStatics) {
+		return;
+	}
+	staticTreeDirty = false;
+	staticTree.Clear();
+	for (GameObject* o : staticObjects) {
+		o->UpdateBroadphaseAABB();
+		Vector3 halfSizes;
+		if (o->GetBroadphaseAABB(halfSizes)) {
+			staticTree.Insert(o, o->GetTransform().GetPosition(), halfSizes);
+		}
+	}
+}
+
+/*
+Moving objects live in their own tree, with a fat margin so that objects
+that only shuffle about a little don't have to be reinserted. Proxies are
+only added and removed when the world changes - otherwise we just refit.
+*/
+void GameWorld::UpdateQueryTrees() {
+	UpdatePartitions();
+
+	if (queryTreeWorldState != worldStateCounter) {
+		std::unordered_map<GameObject*, int> newProxies;
+		for (const std::vector<GameObject*>* objects : { &kinematicObjects, &dynamicObjects }) {
+			for (GameObject* o : *objects) {
+				o->UpdateBroadphaseAABB();
+				Vector3 halfSizes;
+				if (!o->GetBroadphaseAABB(halfSizes)) {
+					continue;
+				}
+				auto existing = movingProxies.find(o);
+				if (existing != movingProxies.end()) {
+					newProxies.insert(*existing);
+					movingProxies.erase(existing);
+				}
+				else {
+					newProxies[o] = movingTree.Insert(o, o->GetTransform().GetPosition(), halfSizes);
+				}
+			}
+		}
+		for (auto& [object, proxy] : movingProxies) {
+			movingTree.Remove(proxy);
+		}
+		movingProxies		= std::move(newProxies);
+		queryTreeWorldState = worldStateCounter;
+	}
+	for (auto& [object, proxy] : movingProxies) {
+		object->UpdateBroadphaseAABB();
+		Vector3 halfSizes;
+		object->GetBroadphaseAABB(halfSizes);
+		movingTree.Update(proxy, object->GetTransform().GetPosition(), halfSizes);
+	}
+}
+
+void GameWorld::UpdateTransforms() {
+	dirtyTransforms.clear();
+	for (GameObject* o : gameObjects) {
+		Transform& t = o->GetTransform();
+		if (t.IsMatrixDirty()) {
+			dirtyTransforms.push_back(&t);
+		}
+	}
+	Transform::UpdateMatrices(dirtyTransforms.data(), dirtyTransforms.size());
+}
+
+void GameWorld::OperateOnContentsParallel(GameObjectFunc f, size_t batchSize) {
+	JobSystem::GetShared().ParallelFor(gameObjects.size(), batchSize,
+		[&](size_t start, size_t end, unsigned int slot) {
+			for (size_t i = start; i < end; ++i) {
+				f(gameObjects[i]);
+			}
+		}
+	);
+}
+
 void GameWorld::OperateOnContents(GameObjectFunc f) {
 	for (GameObject* g : gameObjects) {
 		f(g);
@@ -64,22 +214,259 @@ void GameWorld::OperateOnContents(GameObjectFunc f) {
 }
 
 void GameWorld::UpdateWorld(float dt) {
-	auto rng = std::default_random_engine{};
-
-	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-	std::default_random_engine e(seed);
-
 	if (shuffleObjects) {
-		std::shuffle(gameObjects.begin(), gameObjects.end(), e);
+		Shuffle(gameObjects);
 	}
 
 	if (shuffleConstraints) {
-		std::shuffle(constraints.begin(), constraints.end(), e);
+		Shuffle(constraints);
+	}
+}
+
+/*
+A plain Fisher-Yates shuffle, rather than std::shuffle - how that picks its
+random numbers is up to the standard library, so the same seed could give a
+different order on a different compiler, which is no good for lockstep.
+*/
+template<class T>
+void GameWorld::Shuffle(std::vector<T>& items) {
+	for (size_t i = items.size(); i > 1; --i) {
+		size_t j = shuffleEngine() % i;
+		std::swap(items[i - 1], items[j]);
 	}
 }
 
 bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignoreThis) const {
-	//The simplest raycast just goes through each object and sees if there's a collision
+	if (queryTreeWorldState != worldStateCounter) {
+		return RaycastAllObjects(r, closestCollision, closestObject, ignoreThis);
+	}
+	RayCollision collision;
+
+	for (const AABBTree<GameObject*>* tree : { &staticTree, &movingTree }) {
+		tree->RayCast(r.GetPosition(), r.GetDirection(), collision.rayDistance, [&](int proxy, float maxDistance) {
+			GameObject* o = tree->GetObject(proxy);
+			RayCollision thisCollision;
+			if (o == ignoreThis || !CollisionDetection::RayIntersection(r, *o, thisCollision) || thisCollision.rayDistance >= collision.rayDistance) {
+				return maxDistance;
+			}
+			thisCollision.node	= o;
+			collision			= thisCollision;
+			return closestObject ? collision.rayDistance : -1.0f;
+		});
+		if (collision.node && !closestObject) {
+			break;
+		}
+	}
+	if (collision.node) {
+		closestCollision = collision;
+		return true;
+	}
+	return false;
+}
+
+size_t GameWorld::RaycastBatch(const Ray* rays, size_t count, RayCollision* results, GameObject* ignoreThis) const {
+	size_t hitCount = 0;
+
+	if (queryTreeWorldState != worldStateCounter) {
+		for (size_t i = 0; i < count; ++i) {
+			results[i] = RayCollision();
+			hitCount += RaycastAllObjects(rays[i], results[i], true, ignoreThis) ? 1 : 0;
+		}
+		return hitCount;
+	}
+	const int packetSize = AABBTree<GameObject*>::RayPacketSize;
+
+	for (size_t first = 0; first < count; first += packetSize) {
+		int rayCount = (int)std::min(count - first, (size_t)packetSize);
+
+		Vector3 origins[packetSize];
+		Vector3 directions[packetSize];
+		float	maxDistances[packetSize];
+		for (int i = 0; i < rayCount; ++i) {
+			origins[i]			= rays[first + i].GetPosition();
+			directions[i]		= rays[first + i].GetDirection();
+			maxDistances[i]		= FLT_MAX;
+			results[first + i]	= RayCollision();
+		}
+		for (const AABBTree<GameObject*>* tree : { &staticTree, &movingTree }) {
+			tree->RayCastPacket(origins, directions, maxDistances, rayCount, [&](int proxy, unsigned int rayMask) {
+				GameObject* o = tree->GetObject(proxy);
+				if (o == ignoreThis) {
+					return;
+				}
+				for (; rayMask != 0; rayMask &= rayMask - 1) {
+					int i = std::countr_zero(rayMask);
+					RayCollision thisCollision;
+					if (CollisionDetection::RayIntersection(rays[first + i], *o, thisCollision) && thisCollision.rayDistance < maxDistances[i]) {
+						thisCollision.node	= o;
+						results[first + i]	= thisCollision;
+						maxDistances[i]		= thisCollision.rayDistance;
+					}
+				}
+			});
+		}
+		for (int i = 0; i < rayCount; ++i) {
+			hitCount += results[first + i].node ? 1 : 0;
+		}
+	}
+	return hitCount;
+}
+
+template<typename Func>
+void GameWorld::QueryBounds(const Vector3& position, const Vector3& halfSize, Func&& func) const {
+	if (queryTreeWorldState != worldStateCounter) {
+		for (GameObject* o : gameObjects) {
+			if (o->GetBoundingVolume() && !func(o)) {
+				return;
+			}
+		}
+		return;
+	}
+	bool keepGoing = true;
+	for (const AABBTree<GameObject*>* tree : { &staticTree, &movingTree }) {
+		tree->Query(position, halfSize, [&](int proxy) {
+			keepGoing = func(tree->GetObject(proxy));
+			return keepGoing;
+		});
+		if (!keepGoing) {
+			return;
+		}
+	}
+}
+
+/*
+We don't know which way around the query volume might be, so it's bounded
+by a cube that would fit it however it was rotated.
+*/
+size_t GameWorld::OverlapVolume(const CollisionVolume& volume, const Transform& transform, GameObject** results, size_t maxResults, GameObject* ignoreThis) const {
+	size_t	found	= 0;
+	float	radius	= CollisionDetection::VolumeOuterRadius(volume);
+	if (maxResults == 0) {
+		return 0;
+	}
+	QueryBounds(transform.GetPosition(), Vector3(radius, radius, radius), [&](GameObject* o) {
+		if (o == ignoreThis) {
+			return true;
+		}
+		const CollisionVolume* otherVolume = o->GetBoundingVolume();
+		CollisionDetection::IntersectionTest test = CollisionDetection::GetIntersectionTest(volume.type, otherVolume->type);
+
+		CollisionDetection::CollisionInfo info;
+		if (test && test(volume, transform, *otherVolume, o->GetTransform(), info)) {
+			results[found++] = o;
+		}
+		return found < maxResults;
+	});
+	return found;
+}
+
+size_t GameWorld::OverlapSphere(const Vector3& position, float radius, GameObject** results, size_t maxResults, GameObject* ignoreThis) const {
+	SphereVolume	sphere(radius);
+	Transform		transform;
+	transform.SetPosition(position);
+	return OverlapVolume(sphere, transform, results, maxResults, ignoreThis);
+}
+
+size_t GameWorld::OverlapBox(const Vector3& position, const Vector3& halfSize, GameObject** results, size_t maxResults, GameObject* ignoreThis) const {
+	AABBVolume	box(halfSize);
+	Transform	transform;
+	transform.SetPosition(position);
+	return OverlapVolume(box, transform, results, maxResults, ignoreThis);
+}
+
+size_t GameWorld::OverlapObject(GameObject& object, GameObject** results, size_t maxResults) const {
+	size_t found = 0;
+	Vector3 halfSizes;
+	if (maxResults == 0 || !object.GetBroadphaseAABB(halfSizes)) {
+		return 0;
+	}
+	QueryBounds(object.GetTransform().GetPosition(), halfSizes, [&](GameObject* o) {
+		CollisionDetection::CollisionInfo info;
+		if (o != &object && CollisionDetection::ObjectIntersection(&object, o, info)) {
+			results[found++] = o;
+		}
+		return found < maxResults;
+	});
+	return found;
+}
+
+bool GameWorld::SweepSphere(const Vector3& start, float radius, const Vector3& direction, float maxDistance, RayCollision& hit, GameObject* ignoreThis) const {
+	Vector3 end			= start + direction * maxDistance;
+	Vector3 motion		= end - start;
+	Vector3 sweepPos	= (start + end) * 0.5f;
+	//Swept boxes are grown by the radius along their own axes, so a rotated one can reach sqrt(3) times as far
+	float	reach		= radius * 1.7321f;
+	Vector3 sweepSize	= Vector3(std::abs(motion.x), std::abs(motion.y), std::abs(motion.z)) * 0.5f + Vector3(reach, reach, reach);
+
+	float		firstImpact = 1.0f;
+	GameObject* firstObject = nullptr;
+
+	QueryBounds(sweepPos, sweepSize, [&](GameObject* o) {
+		float timeOfImpact;
+		if (o != ignoreThis && CollisionDetection::SweptSphereIntersection(radius, start, end, *o->GetBoundingVolume(), o->GetTransform(), timeOfImpact)
+			&& timeOfImpact < firstImpact) {
+			firstImpact = timeOfImpact;
+			firstObject = o;
+		}
+		return true;
+	});
+	if (!firstObject) {
+		return false;
+	}
+	hit.node		= firstObject;
+	hit.rayDistance = firstImpact * maxDistance;
+	hit.collidedAt	= start + direction * hit.rayDistance;
+	return true;
+}
+
+/*
+Results are kept sorted as we go, so once the buffer is full, the furthest
+result tells the traversal how far away it's still worth looking.
+*/
+size_t GameWorld::NearestObjects(const Vector3& position, NearbyObject* results, size_t maxResults, float maxDistance, const GameObjectFilter& filter) const {
+	size_t	found = 0;
+	float	limit = maxDistance;
+	if (maxResults == 0) {
+		return 0;
+	}
+	auto TryObject = [&](GameObject* o) {
+		if (filter && !filter(o)) {
+			return;
+		}
+		float distance = Vector::Length(o->GetTransform().GetPosition() - position);
+		if (distance > limit || (found == maxResults && distance >= limit)) {
+			return;
+		}
+		size_t i = std::min(found, maxResults - 1); //Drops the furthest result if we're full
+		for (; i > 0 && results[i - 1].distance > distance; --i) {
+			results[i] = results[i - 1];
+		}
+		results[i] = { o, distance };
+		found = std::min(found + 1, maxResults);
+		if (found == maxResults) {
+			limit = results[found - 1].distance;
+		}
+	};
+	if (queryTreeWorldState != worldStateCounter) {
+		for (GameObject* o : gameObjects) {
+			if (o->GetBoundingVolume()) {
+				TryObject(o);
+			}
+		}
+		return found;
+	}
+	//An object's position is inside its box, so the box is never further away than the object
+	for (const AABBTree<GameObject*>* tree : { &staticTree, &movingTree }) {
+		tree->NearestQuery(position, limit, [&](int proxy, float) {
+			TryObject(tree->GetObject(proxy));
+			return limit;
+		});
+	}
+	return found;
+}
+
+//The simplest raycast just goes through each object and sees if there's a collision
+bool GameWorld::RaycastAllObjects(const Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignoreThis) const {
 	RayCollision collision;
 
 	for (auto& i : gameObjects) {
@@ -93,8 +480,8 @@ bool GameWorld::Raycast(Ray& r, RayCollision& closestCollision, bool closestObje
 		if (CollisionDetection::RayIntersection(r, *i, thisCollision)) {
 				
 			if (!closestObject) {	
-				closestCollision		= collision;
-				closestCollision.node = i;
+				closestCollision		= thisCollision;
+				closestCollision.node	= i;
 				return true;
 			}
 			else {
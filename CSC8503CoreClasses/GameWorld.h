@@ -1,9 +1,12 @@
 #pragma once
 #include <random>
+#include <unordered_map>
 
 #include "Ray.h"
 #include "CollisionDetection.h"
 #include "QuadTree.h"
+#include "AABBTree.h"
+#include "JobSystem.h"
 namespace NCL {
 		class Camera;
 		using Maths::Ray;
@@ -12,8 +15,25 @@ namespace NCL {
 		class Constraint;
 
 		typedef std::function<void(GameObject*)> GameObjectFunc;
+		typedef std::function<bool(const GameObject*)> GameObjectFilter;
 		typedef std::vector<GameObject*>::const_iterator GameObjectIterator;
 
+		/*
+		Static objects never move, kinematic objects are moved by the game
+		rather than pushed around by collisions, and dynamic objects are
+		fully simulated. Objects without a PhysicsObject count as static.
+		*/
+		enum class BodyType {
+			Static,
+			Kinematic,
+			Dynamic
+		};
+
+		struct NearbyObject {
+			GameObject* object;
+			float		distance;
+		};
+
 		class GameWorld	{
 		public:
 			GameWorld();
@@ -40,16 +60,125 @@ namespace NCL {
 				shuffleObjects = state;
 			}
 
+			//Shuffles are seeded from the clock unless given a seed here
+			void SetShuffleSeed(unsigned int seed) {
+				shuffleEngine.seed(seed);
+			}
+
+			/*
+			Rays are traced through the static tree and the moving object tree,
+			nearest boxes first, so a closest hit query can stop as soon as
+			there's nothing left that could be closer. If objects have been added
+			or removed since UpdateQueryTrees was last called, the trees can't be
+			trusted, and we fall back to testing every object.
+			*/
 			bool Raycast(Ray& r, RayCollision& closestCollision, bool closestObject = false, GameObject* ignore = nullptr) const;
 
+			/*
+			Finds the closest hit for each of a whole set of rays, writing them
+			into results (with a null node for rays that hit nothing), and
+			returns how many rays hit something. Rays are traced in packets of
+			consecutive rays, so keep rays that start near each other and point
+			the same way (an agent's line of sight checks, say) next to each other.
+			*/
+			size_t RaycastBatch(const Ray* rays, size_t count, RayCollision* results, GameObject* ignore = nullptr) const;
+
+			/*
+			Shape queries. Overlap queries write the objects whose collision
+			volumes overlap the given shape into results, stopping once it's full,
+			and return how many they wrote. Like raycasts, they use the query
+			trees, and fall back to testing every object if those are out of date.
+			*/
+			size_t OverlapVolume(const CollisionVolume& volume, const Transform& transform, GameObject** results, size_t maxResults, GameObject* ignore = nullptr) const;
+			size_t OverlapSphere(const Vector3& position, float radius, GameObject** results, size_t maxResults, GameObject* ignore = nullptr) const;
+			size_t OverlapBox(const Vector3& position, const Vector3& halfSize, GameObject** results, size_t maxResults, GameObject* ignore = nullptr) const;
+			size_t OverlapObject(GameObject& object, GameObject** results, size_t maxResults) const;
+
+			/*
+			Moves a sphere along a (normalised) direction, and finds the first
+			object it would hit within maxDistance. rayDistance is how far the
+			sphere got, and collidedAt is where its centre was at the time. As
+			with continuous collision detection, objects the sphere starts off
+			inside of aren't counted.
+			*/
+			bool SweepSphere(const Vector3& start, float radius, const Vector3& direction, float maxDistance, RayCollision& hit, GameObject* ignore = nullptr) const;
+
+			/*
+			Finds the objects whose positions are closest to the given point,
+			writing up to maxResults of them into results, nearest first, and
+			returns how many it found. Only objects with a collision volume, and
+			that the filter (if there is one) accepts, are considered.
+			*/
+			size_t NearestObjects(const Vector3& position, NearbyObject* results, size_t maxResults,
+				float maxDistance = FLT_MAX, const GameObjectFilter& filter = nullptr) const;
+
+			/*
+			Brings the moving object tree used by raycasts up to date with where
+			the kinematic and dynamic objects are now. The PhysicsSystem does this
+			at the end of every update - call it yourself if you move objects
+			around some other way and then want to raycast against them.
+			*/
+			void UpdateQueryTrees();
+
+			/*
+			Rebuilds the matrix of every object that has moved since its matrix
+			was last built, all in one batch - call it once a frame, after
+			everything has finished moving and before rendering.
+			*/
+			void UpdateTransforms();
+
 			virtual void UpdateWorld(float dt);
 
 			void OperateOnContents(GameObjectFunc f);
 
+			/*
+			Calls f on every object, sharing the objects out in batches over the
+			shared JobSystem - so f will be running on several threads at once,
+			in no particular order, and mustn't touch anything another object's
+			call might. Nothing may be added to or removed from the world until
+			it returns.
+			*/
+			void OperateOnContentsParallel(GameObjectFunc f, size_t batchSize = 64);
+
+			size_t GetObjectCount() const {
+				return gameObjects.size();
+			}
+
+			void GetObjectIterators(
+				GameObjectIterator& first,
+				GameObjectIterator& last) const;
+
+			//Only valid after UpdatePartitions has been called
 			void GetObjectIterators(
+				BodyType type,
 				GameObjectIterator& first,
 				GameObjectIterator& last) const;
 
+			static BodyType GetBodyType(const GameObject* o);
+
+			/*
+			Sorts the objects into their static, kinematic and dynamic lists,
+			and builds the static object tree. This only does anything if the
+			world has changed since the last call, so it's cheap to call every
+			frame - but an object changing type after it has been added, or a
+			static object being moved, isn't a change to the world, so call
+			MarkPartitionsDirty if you do either of those.
+			*/
+			void UpdatePartitions();
+
+			void MarkPartitionsDirty() {
+				staticTreeDirty = true;
+				worldStateCounter++;
+			}
+
+			const AABBTree<GameObject*>& GetStaticTree() const {
+				return staticTree;
+			}
+
+			const AABBTree<GameObject*>& GetMovingTree() const {
+				return movingTree;
+			}
+
 			void GetConstraintIterators(
 				std::vector<Constraint*>::const_iterator& first,
 				std::vector<Constraint*>::const_iterator& last) const;
@@ -59,13 +188,36 @@ namespace NCL {
 			}
 
 		protected:
+			template<class T>
+			void Shuffle(std::vector<T>& items);
+
+			bool RaycastAllObjects(const Ray& r, RayCollision& closestCollision, bool closestObject, GameObject* ignore) const;
+
+			//Calls func(object) for every object whose bounds might overlap the box, until func returns false
+			template<typename Func>
+			void QueryBounds(const Vector3& position, const Vector3& halfSize, Func&& func) const;
+
 			std::vector<GameObject*> gameObjects;
 			std::vector<Constraint*> constraints;
 
+			std::vector<GameObject*> staticObjects;
+			std::vector<GameObject*> kinematicObjects;
+			std::vector<GameObject*> dynamicObjects;
+			AABBTree<GameObject*>	 staticTree;
+			int						 partitionWorldState;
+			bool					 staticTreeDirty;
+
+			AABBTree<GameObject*>					movingTree;
+			std::unordered_map<GameObject*, int>	movingProxies;
+			int										queryTreeWorldState;
+
+			std::vector<Transform*>	dirtyTransforms;
+
 			PerspectiveCamera mainCamera;
 
 			bool shuffleConstraints;
 			bool shuffleObjects;
+			std::mt19937 shuffleEngine;
 			int		worldIDCounter;
 			int		worldStateCounter;
 		};
@@ -0,0 +1,114 @@
+#include "NarrowPhaseKernels.h"
+#include "SIMDLanes.h"
+#include <algorithm>
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+Turns the offset from the closest point on A to the centre of sphere B into
+a contact - the same steps as normalising the offset with Vector::Normalise,
+which leaves a zero length offset as a zero normal.
+*/
+template<class L>
+static void StoreContact(const ContactBatchArrays& p, size_t i, typename L::V dx, typename L::V dy, typename L::V dz,
+	typename L::V distance, typename L::V penetration, typename L::V radiusB) {
+	typedef typename L::V V;
+	const V zero	= L::Set(0.0f);
+	const V minus	= L::Set(-1.0f);
+
+	V inverse = L::Div(L::Set(1.0f), distance);
+	V nx = L::SelectPositive(distance, L::Mul(dx, inverse), zero);
+	V ny = L::SelectPositive(distance, L::Mul(dy, inverse), zero);
+	V nz = L::SelectPositive(distance, L::Mul(dz, inverse), zero);
+
+	L::Store(p.normal[0] + i, nx);
+	L::Store(p.normal[1] + i, ny);
+	L::Store(p.normal[2] + i, nz);
+	L::Store(p.penetration + i, penetration);
+	L::Store(p.localB[0] + i, L::Mul(L::Mul(nx, minus), radiusB));
+	L::Store(p.localB[1] + i, L::Mul(L::Mul(ny, minus), radiusB));
+	L::Store(p.localB[2] + i, L::Mul(L::Mul(nz, minus), radiusB));
+}
+
+template<class L>
+static size_t SphereSphereLanes(const ContactBatchArrays& p, size_t first, size_t last) {
+	typedef typename L::V V;
+	size_t i = first;
+	for (; i + L::Width <= last; i += L::Width) {
+		V radiusA = L::Load(p.extentA[0] + i);
+		V radiusB = L::Load(p.radiusB + i);
+		V radii	= L::Add(radiusA, radiusB);
+
+		V dx = L::Sub(L::Load(p.positionB[0] + i), L::Load(p.positionA[0] + i));
+		V dy = L::Sub(L::Load(p.positionB[1] + i), L::Load(p.positionA[1] + i));
+		V dz = L::Sub(L::Load(p.positionB[2] + i), L::Load(p.positionA[2] + i));
+		V distance = L::Sqrt(L::Add(L::Add(L::Mul(dx, dx), L::Mul(dy, dy)), L::Mul(dz, dz)));
+
+		StoreContact<L>(p, i, dx, dy, dz, distance, L::Sub(radii, distance), radiusB);
+		L::Store(p.localA[0] + i, L::Mul(L::Load(p.normal[0] + i), radiusA));
+		L::Store(p.localA[1] + i, L::Mul(L::Load(p.normal[1] + i), radiusA));
+		L::Store(p.localA[2] + i, L::Mul(L::Load(p.normal[2] + i), radiusA));
+	}
+	return i;
+}
+
+/*
+The contact is on the AABB at the point closest to the sphere's centre, but
+(as with AABBSphereIntersection) it's reported at the AABB's centre, as an
+AABB can't be made to spin by it anyway.
+*/
+template<class L>
+static size_t AABBSphereLanes(const ContactBatchArrays& p, size_t first, size_t last) {
+	typedef typename L::V V;
+	const V zero	= L::Set(0.0f);
+	const V minus	= L::Set(-1.0f);
+
+	size_t i = first;
+	for (; i + L::Width <= last; i += L::Width) {
+		V offset[3];
+		for (int axis = 0; axis < 3; ++axis) {
+			V half	= L::Load(p.extentA[axis] + i);
+			V delta = L::Sub(L::Load(p.positionB[axis] + i), L::Load(p.positionA[axis] + i));
+			V clamped = L::Min(half, L::Max(L::Mul(half, minus), delta));
+			offset[axis] = L::Sub(delta, clamped);
+		}
+		V radiusB	= L::Load(p.radiusB + i);
+		V distance	= L::Sqrt(L::Add(L::Add(L::Mul(offset[0], offset[0]), L::Mul(offset[1], offset[1])), L::Mul(offset[2], offset[2])));
+
+		StoreContact<L>(p, i, offset[0], offset[1], offset[2], distance, L::Sub(radiusB, distance), radiusB);
+		L::Store(p.localA[0] + i, zero);
+		L::Store(p.localA[1] + i, zero);
+		L::Store(p.localA[2] + i, zero);
+	}
+	return i;
+}
+
+template<class L>
+static void SphereSphere(const ContactBatchArrays& p, size_t first, size_t last) {
+	size_t done = SphereSphereLanes<L>(p, first, last);
+	SphereSphereLanes<ScalarLane>(p, done, last);
+}
+
+template<class L>
+static void AABBSphere(const ContactBatchArrays& p, size_t first, size_t last) {
+	size_t done = AABBSphereLanes<L>(p, first, last);
+	AABBSphereLanes<ScalarLane>(p, done, last);
+}
+
+template<class L>
+static const NarrowPhaseKernels kernelsFor = {
+	&SphereSphere<L>,
+	&AABBSphere<L>
+};
+
+const NarrowPhaseKernels& NCL::CSC8503::GetNarrowPhaseKernels(SIMDLevel level) {
+	level = std::min(level, GetSupportedSIMDLevel());
+	switch (level) {
+#ifdef NCL_AVX2_KERNELS
+		case SIMDLevel::AVX2:	return kernelsFor<AVX2Lane>;
+#endif
+		case SIMDLevel::SSE:	return kernelsFor<SSELane>;
+		default:				return kernelsFor<ScalarLane>;
+	}
+}
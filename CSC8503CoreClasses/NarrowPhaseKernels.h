@@ -0,0 +1,42 @@
+#pragma once
+#include "RigidBodyKernels.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A batch of collision pairs that all have the same volume types, laid
+		out as one array per component like the RigidBodyArrays. Volume A is
+		described by its position and extents (its half size for an AABB, or
+		its radius in every component for a sphere), and volume B is always
+		a sphere.
+
+		The kernels fill in a contact for every pair - pairs that aren't
+		touching are left with a penetration of 0 or less.
+		*/
+		struct ContactBatchArrays {
+			size_t			count;
+			const float*	positionA[3];
+			const float*	extentA[3];
+			const float*	positionB[3];
+			const float*	radiusB;
+
+			float*			normal[3];
+			float*			penetration;
+			float*			localA[3];
+			float*			localB[3];
+		};
+
+		/*
+		Batched versions of CollisionDetection's sphere/sphere and AABB/sphere
+		tests, in the same scalar, SSE and AVX2 flavours as the integrators.
+		They do exactly the same float operations as the single pair tests,
+		so a pair gets bitwise the same contact whichever way it's tested.
+		*/
+		struct NarrowPhaseKernels {
+			void (*sphereSphere)(const ContactBatchArrays& pairs, size_t first, size_t last);
+			void (*aabbSphere)(const ContactBatchArrays& pairs, size_t first, size_t last);
+		};
+
+		const NarrowPhaseKernels& GetNarrowPhaseKernels(SIMDLevel level);
+	}
+}
@@ -11,38 +11,157 @@ PhysicsObject::PhysicsObject(Transform* parentTransform, const CollisionVolume*
 	inverseMass = 1.0f;
 	elasticity	= 0.8f;
 	friction	= 0.8f;
+	kinematic	= false;
+	fastMoving	= false;
+
+	//Nothing has been given any inertia yet
+	inverseInteriaTensor = Matrix::Scale3x3(inverseInertia);
+
+	bodyStore	= nullptr;
+	bodyHandle	= RigidBodyStore::NullHandle;
 }
 
 PhysicsObject::~PhysicsObject()	{
+	DetachFromStore();
+}
+
+/*
+Moves our state into the store, which takes over as the one true copy of it
+until we're detached again, at which point it gets copied back.
+*/
+void PhysicsObject::AttachToStore(RigidBodyStore* store) {
+	if (bodyStore) {
+		return;
+	}
+	bodyHandle	= store->Add(this, transform);
+	bodyStore	= store;
+
+	bodyStore->SetLinearVelocity(bodyHandle, linearVelocity);
+	bodyStore->SetAngularVelocity(bodyHandle, angularVelocity);
+	bodyStore->SetForce(bodyHandle, force);
+	bodyStore->SetTorque(bodyHandle, torque);
+	bodyStore->SetInverseMass(bodyHandle, inverseMass);
+	bodyStore->SetInverseInertia(bodyHandle, inverseInertia);
+	bodyStore->UpdateInertiaTensor(bodyHandle);
+}
+
+void PhysicsObject::DetachFromStore() {
+	if (!bodyStore) {
+		return;
+	}
+	linearVelocity			= bodyStore->GetLinearVelocity(bodyHandle);
+	angularVelocity			= bodyStore->GetAngularVelocity(bodyHandle);
+	force					= bodyStore->GetForce(bodyHandle);
+	torque					= bodyStore->GetTorque(bodyHandle);
+	inverseMass				= bodyStore->GetInverseMass(bodyHandle);
+	inverseInertia			= bodyStore->GetInverseInertia(bodyHandle);
+	inverseInteriaTensor	= bodyStore->GetInertiaTensor(bodyHandle);
+
+	bodyStore->Remove(bodyHandle);
+	bodyStore	= nullptr;
+	bodyHandle	= RigidBodyStore::NullHandle;
+}
+
+void PhysicsObject::SetInverseMass(float invMass) {
+	if (bodyStore) {
+		bodyStore->SetInverseMass(bodyHandle, invMass);
+	}
+	else {
+		inverseMass = invMass;
+	}
+}
+
+void PhysicsObject::SetLinearVelocity(const Vector3& v) {
+	if (bodyStore) {
+		Wake();
+		bodyStore->SetLinearVelocity(bodyHandle, v);
+	}
+	else {
+		linearVelocity = v;
+	}
+}
+
+void PhysicsObject::SetAngularVelocity(const Vector3& v) {
+	if (bodyStore) {
+		Wake();
+		bodyStore->SetAngularVelocity(bodyHandle, v);
+	}
+	else {
+		angularVelocity = v;
+	}
+}
 
+void PhysicsObject::SetInverseInertia(const Vector3& i) {
+	if (bodyStore) {
+		bodyStore->SetInverseInertia(bodyHandle, i);
+	}
+	else {
+		//Objects the PhysicsSystem isn't simulating never have this
+		//recalculated for them, but the solver still reads it
+		inverseInertia = i;
+		UpdateInertiaTensor();
+	}
 }
 
+/*
+Impulses come from the collision and constraint solvers, which only ever
+work on objects the PhysicsSystem has already woken up, so unlike the
+functions below, these leave the sleep state alone.
+*/
 void PhysicsObject::ApplyAngularImpulse(const Vector3& force) {
-	angularVelocity += inverseInteriaTensor * force;
+	if (bodyStore) {
+		bodyStore->SetAngularVelocity(bodyHandle, GetAngularVelocity() + GetInertiaTensor() * force);
+	}
+	else {
+		angularVelocity += inverseInteriaTensor * force;
+	}
 }
 
 void PhysicsObject::ApplyLinearImpulse(const Vector3& force) {
-	linearVelocity += force * inverseMass;
+	if (bodyStore) {
+		bodyStore->SetLinearVelocity(bodyHandle, GetLinearVelocity() + force * GetInverseMass());
+	}
+	else {
+		linearVelocity += force * inverseMass;
+	}
 }
 
 void PhysicsObject::AddForce(const Vector3& addedForce) {
-	force += addedForce;
+	if (bodyStore) {
+		Wake();
+		bodyStore->SetForce(bodyHandle, bodyStore->GetForce(bodyHandle) + addedForce);
+	}
+	else {
+		force += addedForce;
+	}
 }
 
 void PhysicsObject::AddForceAtPosition(const Vector3& addedForce, const Vector3& position) {
 	Vector3 localPos = position - transform->GetPosition();
 
-	force  += addedForce;
-	torque += Vector::Cross(localPos, addedForce);
+	AddForce(addedForce);
+	AddTorque(Vector::Cross(localPos, addedForce));
 }
 
 void PhysicsObject::AddTorque(const Vector3& addedTorque) {
-	torque += addedTorque;
+	if (bodyStore) {
+		Wake();
+		bodyStore->SetTorque(bodyHandle, bodyStore->GetTorque(bodyHandle) + addedTorque);
+	}
+	else {
+		torque += addedTorque;
+	}
 }
 
 void PhysicsObject::ClearForces() {
-	force				= Vector3();
-	torque				= Vector3();
+	if (bodyStore) {
+		bodyStore->SetForce(bodyHandle, Vector3());
+		bodyStore->SetTorque(bodyHandle, Vector3());
+	}
+	else {
+		force				= Vector3();
+		torque				= Vector3();
+	}
 }
 
 void PhysicsObject::InitCubeInertia() {
@@ -52,20 +171,27 @@ void PhysicsObject::InitCubeInertia() {
 
 	Vector3 dimsSqr		= fullWidth * fullWidth;
 
-	inverseInertia.x = (12.0f * inverseMass) / (dimsSqr.y + dimsSqr.z);
-	inverseInertia.y = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.z);
-	inverseInertia.z = (12.0f * inverseMass) / (dimsSqr.x + dimsSqr.y);
+	float invMass = GetInverseMass();
+	Vector3 i;
+	i.x = (12.0f * invMass) / (dimsSqr.y + dimsSqr.z);
+	i.y = (12.0f * invMass) / (dimsSqr.x + dimsSqr.z);
+	i.z = (12.0f * invMass) / (dimsSqr.x + dimsSqr.y);
+	SetInverseInertia(i);
 }
 
 void PhysicsObject::InitSphereInertia() {
 
 	float radius	= Vector::GetMaxElement(transform->GetScale());
-	float i			= 2.5f * inverseMass / (radius*radius);
+	float i			= 2.5f * GetInverseMass() / (radius*radius);
 
-	inverseInertia	= Vector3(i, i, i);
+	SetInverseInertia(Vector3(i, i, i));
 }
 
 void PhysicsObject::UpdateInertiaTensor() {
+	if (bodyStore) {
+		bodyStore->UpdateInertiaTensor(bodyHandle);
+		return;
+	}
 	Quaternion q = transform->GetOrientation();
 
 	Matrix3 invOrientation = Quaternion::RotationMatrix<Matrix3>(q.Conjugate());
@@ -1,4 +1,5 @@
 #pragma once
+#include "RigidBodyStore.h"
 using namespace NCL::Maths;
 
 namespace NCL {
@@ -7,33 +8,79 @@ namespace NCL {
 	namespace CSC8503 {
 		class Transform;
 
+		/*
+		While a PhysicsObject is being simulated, its state lives in the
+		PhysicsSystem's RigidBodyStore rather than in the object itself - the
+		accessors below forward on to the store whenever we're attached to one.
+		*/
 		class PhysicsObject	{
 		public:
 			PhysicsObject(Transform* parentTransform, const CollisionVolume* parentVolume);
 			~PhysicsObject();
 
 			Vector3 GetLinearVelocity() const {
-				return linearVelocity;
+				return bodyStore ? bodyStore->GetLinearVelocity(bodyHandle) : linearVelocity;
 			}
 
 			Vector3 GetAngularVelocity() const {
-				return angularVelocity;
+				return bodyStore ? bodyStore->GetAngularVelocity(bodyHandle) : angularVelocity;
 			}
 
 			Vector3 GetTorque() const {
-				return torque;
+				return bodyStore ? bodyStore->GetTorque(bodyHandle) : torque;
 			}
 
 			Vector3 GetForce() const {
-				return force;
+				return bodyStore ? bodyStore->GetForce(bodyHandle) : force;
 			}
 
-			void SetInverseMass(float invMass) {
-				inverseMass = invMass;
-			}
+			void SetInverseMass(float invMass);
 
 			float GetInverseMass() const {
-				return inverseMass;
+				return bodyStore ? bodyStore->GetInverseMass(bodyHandle) : inverseMass;
+			}
+
+			void SetElasticity(float e) {
+				elasticity = e;
+			}
+
+			float GetElasticity() const {
+				return elasticity;
+			}
+
+			void SetFriction(float f) {
+				friction = f;
+			}
+
+			float GetFriction() const {
+				return friction;
+			}
+
+			/*
+			Kinematic objects have infinite mass, but unlike static objects
+			they're expected to move - either by being given a velocity, or by
+			the game setting their Transform directly. They push dynamic objects
+			out of their way, but nothing can push them back.
+			*/
+			void SetKinematic(bool state) {
+				kinematic = state;
+			}
+
+			bool IsKinematic() const {
+				return kinematic;
+			}
+
+			/*
+			Fast moving objects are swept along their path each step, and
+			stopped at the first thing they'd hit, so that they can't skip
+			straight through thin objects between one step and the next.
+			*/
+			void SetFastMoving(bool state) {
+				fastMoving = state;
+			}
+
+			bool IsFastMoving() const {
+				return fastMoving;
 			}
 
 			void ApplyAngularImpulse(const Vector3& force);
@@ -48,13 +95,8 @@ namespace NCL {
 
 			void ClearForces();
 
-			void SetLinearVelocity(const Vector3& v) {
-				linearVelocity = v;
-			}
-
-			void SetAngularVelocity(const Vector3& v) {
-				angularVelocity = v;
-			}
+			void SetLinearVelocity(const Vector3& v);
+			void SetAngularVelocity(const Vector3& v);
 
 			void InitCubeInertia();
 			void InitSphereInertia();
@@ -62,16 +104,50 @@ namespace NCL {
 			void UpdateInertiaTensor();
 
 			Matrix3 GetInertiaTensor() const {
-				return inverseInteriaTensor;
+				return bodyStore ? bodyStore->GetInertiaTensor(bodyHandle) : inverseInteriaTensor;
+			}
+
+			void AttachToStore(RigidBodyStore* store);
+			void DetachFromStore();
+
+			RigidBodyStore* GetBodyStore() const {
+				return bodyStore;
+			}
+
+			int GetBodyHandle() const {
+				return bodyHandle;
+			}
+
+			/*
+			Resting objects are put to sleep by the PhysicsSystem, and skip
+			integration and collision detection until something touches them.
+			Adding a force or torque, or setting a velocity, wakes them back up;
+			if you move a sleeping object's Transform yourself, call Wake too.
+			*/
+			bool IsAsleep() const {
+				return bodyStore && !bodyStore->IsAwake(bodyHandle);
+			}
+
+			void Wake() {
+				if (bodyStore) {
+					bodyStore->SetAwake(bodyHandle, true);
+				}
 			}
 
 		protected:
+			void SetInverseInertia(const Vector3& i);
+
 			const CollisionVolume* volume;
 			Transform*		transform;
 
+			RigidBodyStore*	bodyStore;
+			int				bodyHandle;
+
 			float inverseMass;
 			float elasticity;
 			float friction;
+			bool  kinematic;
+			bool  fastMoving;
 
 			//linear stuff
 			Vector3 linearVelocity;
@@ -0,0 +1,127 @@
+#include "PhysicsReplay.h"
+
+#include <fstream>
+#include <cstring>
+
+using namespace NCL;
+using namespace CSC8503;
+
+PhysicsReplay::PhysicsReplay() {
+	mode			= Mode::Idle;
+	nextFrame		= 0;
+	nextStep		= 0;
+	divergedStep	= NoStep;
+}
+
+PhysicsReplay::~PhysicsReplay() {
+}
+
+void PhysicsReplay::BeginRecording() {
+	frameTimes.clear();
+	stepHashes.clear();
+	mode			= Mode::Recording;
+	divergedStep	= NoStep;
+}
+
+void PhysicsReplay::BeginValidating() {
+	mode			= Mode::Validating;
+	nextFrame		= 0;
+	nextStep		= 0;
+	divergedStep	= NoStep;
+}
+
+void PhysicsReplay::Stop() {
+	mode = Mode::Idle;
+}
+
+/*
+Once a validation run has used up the recording, we just let the real time
+deltas through again - there's nothing left to check them against.
+*/
+float PhysicsReplay::FrameTime(float dt) {
+	if (mode == Mode::Recording) {
+		frameTimes.emplace_back(dt);
+	}
+	else if (mode == Mode::Validating && nextFrame < frameTimes.size()) {
+		dt = frameTimes[nextFrame++];
+	}
+	return dt;
+}
+
+void PhysicsReplay::StepHash(uint64_t hash) {
+	if (mode == Mode::Recording) {
+		stepHashes.emplace_back(hash);
+	}
+	else if (mode == Mode::Validating && nextStep < stepHashes.size()) {
+		if (divergedStep == NoStep && stepHashes[nextStep] != hash) {
+			divergedStep = nextStep;
+		}
+		nextStep++;
+	}
+}
+
+/*
+Frame times are written out as their raw bits, as going through a decimal
+string could round them, and then the replay wouldn't be the same.
+*/
+bool PhysicsReplay::Save(const std::string& filename) const {
+	std::ofstream file(filename);
+	if (!file) {
+		return false;
+	}
+	file << frameTimes.size() << " " << stepHashes.size() << "\n";
+	for (float dt : frameTimes) {
+		uint32_t bits;
+		std::memcpy(&bits, &dt, sizeof(float));
+		file << bits << "\n";
+	}
+	for (uint64_t hash : stepHashes) {
+		file << hash << "\n";
+	}
+	return (bool)file;
+}
+
+/*
+A broken replay file shouldn't be able to ask for more memory than it
+could possibly hold values for - each one takes up at least a digit and a
+newline - and the replay we already have is only replaced once the whole
+file has been read in successfully.
+*/
+bool PhysicsReplay::Load(const std::string& filename) {
+	std::ifstream file(filename);
+	if (!file) {
+		return false;
+	}
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	size_t frameCount	= 0;
+	size_t stepCount	= 0;
+	file >> frameCount >> stepCount;
+	if (!file || fileSize < 0) {
+		return false;
+	}
+	size_t maxValues = (size_t)fileSize / 2;
+	if (frameCount > maxValues || stepCount > maxValues - frameCount) {
+		return false;
+	}
+
+	std::vector<float> newFrameTimes(frameCount);
+	for (float& dt : newFrameTimes) {
+		uint32_t bits = 0;
+		file >> bits;
+		std::memcpy(&dt, &bits, sizeof(float));
+	}
+	std::vector<uint64_t> newStepHashes(stepCount);
+	for (uint64_t& hash : newStepHashes) {
+		file >> hash;
+	}
+	if (!file) {
+		return false;
+	}
+	frameTimes	= std::move(newFrameTimes);
+	stepHashes	= std::move(newStepHashes);
+	mode		= Mode::Idle;
+	return true;
+}
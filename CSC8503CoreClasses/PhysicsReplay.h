@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Records what a deterministic PhysicsSystem did, so that the same
+		simulation can be run again later and checked against it.
+
+		While recording, every frame's time delta is kept, along with the
+		state hash at the end of every physics step. While validating, the
+		recorded deltas are fed back in place of the real ones (so every frame
+		is broken into exactly the same steps as before), and each new hash is
+		compared against the recorded one. The first step that doesn't match
+		is remembered, so we know where things started to drift apart.
+
+		Both runs have to start from the same world, with SetDeterministic
+		called on the PhysicsSystem (with the same seed) before the first
+		frame. This only covers the physics itself - anything the game does to the
+		objects between frames (forces from player input and so on) has to be
+		recorded and replayed by the game.
+		*/
+		class PhysicsReplay {
+		public:
+			enum class Mode {
+				Idle,
+				Recording,
+				Validating
+			};
+
+			PhysicsReplay();
+			~PhysicsReplay();
+
+			void BeginRecording();
+			void BeginValidating();
+			void Stop();
+
+			Mode GetMode() const {
+				return mode;
+			}
+
+			//Returns the time delta this frame should actually use
+			float	FrameTime(float dt);
+			void	StepHash(uint64_t hash);
+
+			bool HasDiverged() const {
+				return divergedStep != NoStep;
+			}
+
+			//The first step whose hash didn't match the recording
+			size_t GetDivergedStep() const {
+				return divergedStep;
+			}
+
+			//Validation has used up every recorded frame
+			bool IsFinished() const {
+				return mode == Mode::Validating && nextFrame >= frameTimes.size();
+			}
+
+			size_t GetFrameCount() const {
+				return frameTimes.size();
+			}
+
+			size_t GetStepCount() const {
+				return stepHashes.size();
+			}
+
+			bool Save(const std::string& filename) const;
+			bool Load(const std::string& filename);
+
+			static const size_t NoStep = ~(size_t)0;
+
+		protected:
+			Mode mode;
+
+			std::vector<float>		frameTimes;
+			std::vector<uint64_t>	stepHashes;
+
+			size_t nextFrame;
+			size_t nextStep;
+			size_t divergedStep;
+		};
+	}
+}
@@ -1,22 +1,89 @@
 #include "PhysicsSystem.h"
 #include "PhysicsObject.h"
 #include "GameObject.h"
+#include "RenderObject.h"
 #include "CollisionDetection.h"
 #include "Quaternion.h"
 
 #include "Constraint.h"
 
 #include "Debug.h"
-#include "Window.h"
+#include <algorithm>
+#include <cmath>
 #include <functional>
+#include <unordered_set>
 using namespace NCL;
 using namespace CSC8503;
 
-PhysicsSystem::PhysicsSystem(GameWorld& g) : gameWorld(g)	{
+/*
+Objects that can't move at all (or that are asleep, and so won't be moving
+right now) never need to search for their own pairs - any pair involving
+them will be found by the awake object on the other side of it. Pairs of
+inactive objects don't need testing at all. Kinematic objects have no mass
+either, but they do move, so they have to go looking for whatever they're
+about to push out of the way - including sleeping objects.
+*/
+static bool IsInactiveObject(const GameObject* o) {
+	const PhysicsObject* phys = o->GetPhysicsObject();
+	if (!phys || phys->IsAsleep()) {
+		return true;
+	}
+	return phys->GetInverseMass() == 0.0f && !phys->IsKinematic();
+}
+
+//Whether a pair found by the broadphase should go on to the narrowphase
+static bool IsCollidablePair(const GameObject* a, const GameObject* b) {
+	return (!IsInactiveObject(a) || !IsInactiveObject(b)) && a->CanCollideWith(*b);
+}
+
+static bool IsAsleep(const GameObject* o) {
+	const PhysicsObject* phys = o->GetPhysicsObject();
+	return phys && phys->IsAsleep();
+}
+
+/*
+Pairs are ordered by world ID rather than by address, so that the same two
+objects always end up the same way around, whatever order they were
+allocated in - otherwise the contact normals (and so the exact results of
+the solver) could change from one run to the next.
+*/
+static void SetPairObjects(CollisionDetection::CollisionInfo& info, GameObject* x, GameObject* y) {
+	bool xFirst = x->GetWorldID() < y->GetWorldID();
+	info.a = xFirst ? x : y;
+	info.b = xFirst ? y : x;
+}
+
+//This is the fixed timestep we'd LIKE to have
+const int   idealHZ = 120;
+const float idealDT = 1.0f / idealHZ;
+
+//If physics takes too long, we'll drop the step rate as far as this to keep the framerate up
+const int	minimumHZ				= idealHZ / 8;
+const float stepTimeSmoothing		= 0.1f;		//How much of each new timing sample goes into the averages
+const float stepRaiseHeadroom		= 0.75f;	//Only double the rate if twice the steps would fit in this much of the budget
+const int	stepRateChangeInterval	= 30;		//Updates to wait after changing the rate, while the averages settle
+
+PhysicsSystem::PhysicsSystem(GameWorld& g, JobSystem& j) : gameWorld(g), jobs(j)	{
 	applyGravity	= false;
 	useBroadPhase	= true;	
 	dTOffset		= 0.0f;
 	globalDamping	= 0.995f;
+	interpolate		= false;
+
+	bodies.SetJobSystem(&jobs);
+
+	SetStepRate(idealHZ);
+	stepBudget					= 0.008f;
+	maxSubsteps					= 8;
+	averageStepTime				= 0.0f;
+	averageFrameTime			= 0.0f;
+	stepRateCooldown			= 0;
+	constraintIterationCount	= 10;
+
+	deterministic	= false;
+	stateHash		= 0;
+	stepCount		= 0;
+	replay			= nullptr;
 	SetGravity(Vector3(0.0f, -9.8f, 0.0f));
 }
 
@@ -27,6 +94,30 @@ void PhysicsSystem::SetGravity(const Vector3& g) {
 	gravity = g;
 }
 
+void PhysicsSystem::UseGravity(bool state) {
+	if (state != applyGravity) {
+		bodies.WakeAll(); //Resting objects might not be resting any more!
+	}
+	applyGravity = state;
+}
+
+void PhysicsSystem::SetDeterministic(bool state, unsigned int seed) {
+	deterministic = state;
+	if (state) {
+		SetStepRate(idealHZ);
+		dTOffset	= 0.0f;
+		stepCount	= 0;
+		gameWorld.SetShuffleSeed(seed);
+	}
+}
+
+void PhysicsSystem::SetSleeping(bool state) {
+	if (!state) {
+		bodies.WakeAll();
+	}
+	useSleeping = state;
+}
+
 /*
 
 If the 'game' is ever reset, the PhysicsSystem must be
@@ -38,7 +129,17 @@ any collisions they are in.
 
 */
 void PhysicsSystem::Clear() {
-	allCollisions.clear();
+	bodies.DetachAll();
+	bodyWorldState = -1;
+	allCollisions.Clear();
+	collisionEvents.clear();
+	broadphasePairs.Clear();
+	broadphaseTree.Clear();
+	treeProxies.clear();
+	treeWorldState = -1;
+	sweepAndPrune.Clear();
+	sapProxies.clear();
+	sapWorldState = -1;
 }
 
 /*
@@ -47,68 +148,67 @@ This is the core of the physics engine update
 
 */
 
-bool useSimpleContainer = false;
-
-int constraintIterationCount = 10;
-
-//This is the fixed timestep we'd LIKE to have
-const int   idealHZ = 120;
-const float idealDT = 1.0f / idealHZ;
-
-/*
-This is the fixed update we actually have...
-If physics takes too long it starts to kill the framerate, it'll drop the 
-iteration count down until the FPS stabilises, even if that ends up
-being at a low rate. 
-*/
-int realHZ		= idealHZ;
-float realDT	= idealDT;
-
 void PhysicsSystem::Update(float dt) {	
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::B)) {
-		useBroadPhase = !useBroadPhase;
-		std::cout << "Setting broadphase to " << useBroadPhase << std::endl;
-	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::N)) {
-		useSimpleContainer = !useSimpleContainer;
-		std::cout << "Setting broad container to " << useSimpleContainer << std::endl;
-	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::I)) {
-		constraintIterationCount--;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
-	}
-	if (Window::GetKeyboard()->KeyPressed(KeyCodes::O)) {
-		constraintIterationCount++;
-		std::cout << "Setting constraint iterations to " << constraintIterationCount << std::endl;
-	}
+	collisionEvents.clear();
 
+	if (replay) {
+		dt = replay->FrameTime(dt);
+	}
 	dTOffset += dt; //We accumulate time delta here - there might be remainders from previous frame!
 
 	GameTimer t;
 	t.GetTimeDeltaSeconds();
 
+	gameWorld.UpdatePartitions();
+	SyncRigidBodies();
+	bodies.LoadTransforms();
 	if (useBroadPhase) {
 		UpdateObjectAABBs();
 	}
+
 	int iteratorCount = 0;
 	while(dTOffset > realDT) {
+		if (iteratorCount == maxSubsteps && !deterministic) {
+			dTOffset = std::fmod(dTOffset, realDT); //We can't catch up, so let the lost time go
+			break;
+		}
+		bodies.SavePreviousState(); //So the renderer can blend from here
 		IntegrateAccel(realDT); //Update accelerations from external forces
+		solverContacts.clear();
 		if (useBroadPhase) {
 			BroadPhase();
+			if (deterministic) {
+				SortBroadPhasePairs();
+			}
 			NarrowPhase();
 		}
 		else {
 			BasicCollisionDetection();
 		}
+		UpdateIslands();
 
 		//This is our simple iterative solver - 
 		//we just run things multiple times, slowly moving things forward
-		//and then rechecking that the constraints have been met		
+		//and then rechecking that the constraints have been met. Contacts
+		//are just another constraint, so they're solved in the same loop
 		float constraintDt = realDT /  (float)constraintIterationCount;
 		for (int i = 0; i < constraintIterationCount; ++i) {
 			UpdateConstraints(constraintDt);	
+			SolveContacts();
 		}
+		StoreContactImpulses();
+		BeginContinuousCollision();
 		IntegrateVelocity(realDT); //update positions from new velocity changes
+		ResolveContinuousCollision(realDT);
+		UpdateSleeping(realDT);
+
+		if (deterministic) {
+			stateHash = HashState();
+			stepCount++;
+			if (replay) {
+				replay->StepHash(stateHash);
+			}
+		}
 
 		dTOffset -= realDT;
 		iteratorCount++;
@@ -118,68 +218,219 @@ void PhysicsSystem::Update(float dt) {
 
 	UpdateCollisionList(); //Remove any old collisions
 
+	gameWorld.UpdateQueryTrees(); //So raycasts made before the next update see where things are now
+
 	t.Tick();
 	float updateTime = t.GetTimeDeltaSeconds();
 
-	//Uh oh, physics is taking too long...
-	if (updateTime > realDT) {
-		realHZ /= 2;
-		realDT *= 2;
-		std::cout << "Dropping iteration count due to long physics time...(now " << realHZ << ")\n";
+	//Deterministic runs can't let how long things took change the timestep
+	if (!deterministic) {
+		UpdateStepRate(dt, updateTime, iteratorCount);
+	}
+}
+
+void PhysicsSystem::SetStepRate(int hz) {
+	realHZ = hz;
+	realDT = 1.0f / hz;
+}
+
+/*
+Step costs hardly depend on the step length, so a step at half the rate
+should cost about the same - halving the rate roughly halves the time a
+frame's physics takes.
+*/
+void PhysicsSystem::UpdateStepRate(float dt, float updateTime, int stepsTaken) {
+	if (stepsTaken > 0) {
+		float stepTime = updateTime / stepsTaken;
+		averageStepTime = (averageStepTime > 0.0f) ? averageStepTime + (stepTime - averageStepTime) * stepTimeSmoothing : stepTime;
+	}
+	averageFrameTime = (averageFrameTime > 0.0f) ? averageFrameTime + (dt - averageFrameTime) * stepTimeSmoothing : dt;
+
+	if (stepRateCooldown > 0) {
+		stepRateCooldown--;
+		return;
 	}
-	else if(dt*2 < realDT) { //we have plenty of room to increase iteration count!
-		int temp = realHZ;
-		realHZ *= 2;
-		realDT /= 2;
+	float stepsPerFrame = averageFrameTime / realDT;
+	float frameCost		= averageStepTime * stepsPerFrame;
 
-		if (realHZ > idealHZ) {
-			realHZ = idealHZ;
-			realDT = idealDT;
+	if (realHZ > minimumHZ && (frameCost > stepBudget || stepsPerFrame > maxSubsteps)) {
+		SetStepRate(realHZ / 2);
+		stepRateCooldown = stepRateChangeInterval;
+	}
+	else if (realHZ < idealHZ && frameCost * 2.0f < stepBudget * stepRaiseHeadroom && stepsPerFrame * 2.0f <= maxSubsteps) {
+		SetStepRate(realHZ * 2);
+		stepRateCooldown = stepRateChangeInterval;
+	}
+}
+
+float PhysicsSystem::GetInterpolationAlpha() const {
+	return std::clamp(dTOffset / realDT, 0.0f, 1.0f);
+}
+
+Matrix4 PhysicsSystem::GetRenderMatrix(const GameObject& object) const {
+	const Transform&		transform	= object.GetTransform();
+	const PhysicsObject*	phys		= object.GetPhysicsObject();
+	if (!interpolate || !phys || phys->GetBodyStore() != &bodies) {
+		return transform.GetMatrix();
+	}
+	Vector3		pos;
+	Quaternion	rot;
+	bodies.GetInterpolatedState(phys->GetBodyHandle(), GetInterpolationAlpha(), pos, rot);
+
+	return	Matrix::Translation(pos) *
+			Quaternion::RotationMatrix<Matrix4>(rot) *
+			Matrix::Scale(transform.GetScale());
+}
+
+/*
+Static objects never move, so they can always be drawn straight from their
+transforms. Every other object only writes to its own RenderObject, so they
+can all be worked out at once.
+*/
+void PhysicsSystem::UpdateRenderTransforms() {
+	gameWorld.OperateOnContentsParallel([&](GameObject* o) {
+		RenderObject* r = o->GetRenderObject();
+		if (!r || GameWorld::GetBodyType(o) == BodyType::Static) {
+			return;
 		}
-		if (temp != realHZ) {
-			std::cout << "Raising iteration count due to short physics time...(now " << realHZ << ")\n";
+		if (interpolate) {
+			r->SetSnapshotMatrix(GetRenderMatrix(*o));
 		}
-	}
+		else {
+			r->ClearSnapshot();
+		}
+	});
 }
 
 /*
 Later on we're going to need to keep track of collisions
-across multiple frames, so we store them in a set.
-
-The first time they are added, we tell the objects they are colliding.
-The frame they are to be removed, we tell them they're no longer colliding.
-
-From this simple mechanism, we we build up gameplay interactions inside the
-OnCollisionBegin / OnCollisionEnd functions (removing health when hit by a 
-rocket launcher, gaining a point when the player hits the gold coin, and so on).
+across multiple frames, so we store them in a pair cache.
+
+The first time they are added, we send a Begin event for them. Each step
+they are found colliding again their frame count is topped back up, and
+the frame they are to be removed, we send an End event - every other frame
+they get a Stay event. Pairs that have gone to sleep keep colliding until
+they wake.
+
+From this simple mechanism, we we build up gameplay interactions from the
+events (removing health when hit by a rocket launcher, gaining a point when
+the player hits the gold coin, and so on). Nothing here calls back into the
+game, so the game is free to deal with the events whenever suits it.
 */
 void PhysicsSystem::UpdateCollisionList() {
-	for (std::set<CollisionDetection::CollisionInfo>::iterator i = allCollisions.begin(); i != allCollisions.end(); ) {
-		if ((*i).framesLeft == numCollisionFrames) {
-			i->a->OnCollisionBegin(i->b);
-			i->b->OnCollisionBegin(i->a);
+	for (size_t i = 0; i < allCollisions.Size(); ) {
+		CollisionPairCache::Entry& entry = allCollisions[i];
+		CollisionDetection::CollisionInfo& in = entry.info;
+
+		bool begun = entry.state == CollisionPairState::Begin;
+		if (begun) {
+			AddCollisionEvent(CollisionEvent::Type::Begin, in);
+			entry.state = CollisionPairState::Persist;
 		}
 
-		CollisionDetection::CollisionInfo& in = const_cast<CollisionDetection::CollisionInfo&>(*i);
-		in.framesLeft--;
+		//Sleeping objects aren't tested against each other, but they haven't
+		//moved either, so whatever they were touching they still are
+		if (!IsInactiveObject(in.a) || !IsInactiveObject(in.b)) {
+			in.framesLeft--;
+		}
 
-		if ((*i).framesLeft < 0) {
-			i->a->OnCollisionEnd(i->b);
-			i->b->OnCollisionEnd(i->a);
-			i = allCollisions.erase(i);
+		if (in.framesLeft < 0) {
+			AddCollisionEvent(CollisionEvent::Type::End, in);
+			allCollisions.RemoveAt(i); //The last pair is moved into slot i, so don't advance
 		}
 		else {
+			if (!begun) {
+				AddCollisionEvent(CollisionEvent::Type::Stay, in);
+			}
 			++i;
 		}
 	}
 }
 
-void PhysicsSystem::UpdateObjectAABBs() {
-	gameWorld.OperateOnContents(
-		[](GameObject* g) {
-			g->UpdateBroadphaseAABB();
+void PhysicsSystem::AddCollisionEvent(CollisionEvent::Type type, const CollisionDetection::CollisionInfo& info) {
+	CollisionEvent e;
+	e.type		= type;
+	e.a			= info.a;
+	e.b			= info.b;
+	e.isTrigger = info.a->IsTrigger() || info.b->IsTrigger();
+	if (info.pointCount > 0) {
+		e.normal	= info.points[0].normal;
+		e.point		= info.a->GetTransform().GetPosition() + info.points[0].localA;
+	}
+	collisionEvents.push_back(e);
+}
+
+size_t PhysicsSystem::GetCollisionEvents(const GameObject* object, uint32_t layerMask, CollisionEvent* results, size_t maxResults) const {
+	size_t found = 0;
+	for (const CollisionEvent& e : collisionEvents) {
+		if (found == maxResults) {
+			break;
 		}
-	);
+		if (!object) {
+			if ((e.a->GetCollisionLayer() | e.b->GetCollisionLayer()) & layerMask) {
+				results[found++] = e;
+			}
+			continue;
+		}
+		if (e.a != object && e.b != object) {
+			continue;
+		}
+		CollisionEvent& r = results[found];
+		r = e;
+		if (e.b == object) {
+			std::swap(r.a, r.b);
+			r.normal = -r.normal;
+		}
+		if (r.b->GetCollisionLayer() & layerMask) {
+			found++;
+		}
+	}
+	return found;
+}
+
+void PhysicsSystem::DispatchCollisionEvents() const {
+	for (const CollisionEvent& e : collisionEvents) {
+		if (e.type == CollisionEvent::Type::Begin) {
+			e.a->OnCollisionBegin(e.b);
+			e.b->OnCollisionBegin(e.a);
+		}
+		else if (e.type == CollisionEvent::Type::End) {
+			e.a->OnCollisionEnd(e.b);
+			e.b->OnCollisionEnd(e.a);
+		}
+	}
+}
+
+size_t PhysicsSystem::AddCollision(const CollisionDetection::CollisionInfo& info) {
+	bool isNew;
+	CollisionPairCache::Entry& entry = allCollisions.Add(info, isNew);
+	if (!isNew) {
+		entry.info = info;
+	}
+	entry.info.framesLeft = numCollisionFrames;
+	return allCollisions.IndexOf(entry);
+}
+
+/*
+Static objects had their bounds worked out when the GameWorld sorted them,
+and as they don't move, they never need updating again.
+*/
+//Each object only touches its own AABB, so they can all be done at once
+void PhysicsSystem::UpdateObjectAABBs() {
+	for (BodyType type : { BodyType::Kinematic, BodyType::Dynamic }) {
+		GameObjectIterator first;
+		GameObjectIterator last;
+		gameWorld.GetObjectIterators(type, first, last);
+		jobs.ParallelFor(last - first, aabbBatchSize,
+			[&](size_t start, size_t end, unsigned int slot) {
+				for (auto i = first + start; i != first + end; ++i) {
+					if (!IsAsleep(*i)) {
+						(*i)->UpdateBroadphaseAABB();
+					}
+				}
+			}
+		);
+	}
 }
 
 /*
@@ -204,12 +455,13 @@ void PhysicsSystem::BasicCollisionDetection() {
 			if ((*j)->GetPhysicsObject() == nullptr) {
 				continue;
 			}
+			if ((IsInactiveObject(*i) && IsInactiveObject(*j)) || !(*i)->CanCollideWith(**j)) {
+				continue;
+			}
 			CollisionDetection::CollisionInfo info;
 			if (CollisionDetection::ObjectIntersection(*i, *j, info)) {
 				std::cout << "Collision between " << (*i)->GetName() << " and " << (*j)->GetName() << std::endl;
-				ImpulseResolveCollision(*info.a, *info.b, info.point);
-				info.framesLeft = numCollisionFrames;
-				allCollisions.insert(info);
+				AddContact(info);
 			}
 		}
 	}
@@ -220,51 +472,156 @@ void PhysicsSystem::BasicCollisionDetection() {
 In tutorial 5, we start determining the correct response to a collision,
 so that objects separate back out. 
 
+Rather than fixing each collision up with a single impulse as soon as it's
+found, every contact from this step is gathered up and solved iteratively
+alongside the other constraints. Each contact keeps a running total of the
+impulse it has applied, and it's this total that gets clamped (a contact can
+push, but never pull), so later iterations can take back what earlier ones
+got wrong. The totals are kept on the collision pair between steps, so a
+resting contact starts each step already pushing about as hard as it needs
+to, rather than having to build back up from nothing.
+
+Overlap is removed by asking for a little extra separating velocity, rather
+than by teleporting the objects apart.
+
 */
-void PhysicsSystem::ImpulseResolveCollision(GameObject& a, GameObject& b, CollisionDetection::ContactPoint& p) const {
-	PhysicsObject* physA = a.GetPhysicsObject();
-	PhysicsObject* physB = b.GetPhysicsObject();
+const float contactBiasFactor		= 0.2f;		//How much of the overlap to remove per step
+const float contactSlop				= 0.01f;	//Overlap we let slide, to stop resting contacts jittering
+const float restitutionThreshold	= 1.0f;		//Slower impacts than this don't bounce
+const float warmStartMatchDistance	= 0.1f;		//How far a contact point can drift and still count as the same one
+
+void PhysicsSystem::AddSolverContact(const CollisionDetection::CollisionInfo& info, size_t pairIndex, float dt) {
+	for (int i = 0; i < info.pointCount; ++i) {
+		AddSolverContact(info, info.points[i], pairIndex, dt);
+	}
+}
 
-	Transform& transformA = a.GetTransform();
-	Transform& transformB = b.GetTransform();
+void PhysicsSystem::AddSolverContact(const CollisionDetection::CollisionInfo& info, const CollisionDetection::ContactPoint& p, size_t pairIndex, float dt) {
+	PhysicsObject* physA = info.a->GetPhysicsObject();
+	PhysicsObject* physB = info.b->GetPhysicsObject();
 
 	float totalMass = physA->GetInverseMass() + physB->GetInverseMass();
-
 	if (totalMass == 0) {
 		return;
 	}
 
-	transformA.SetPosition(transformA.GetPosition() - (p.normal * p.penetration * (physA->GetInverseMass() / totalMass)));
-	transformB.SetPosition(transformB.GetPosition() - (p.normal * p.penetration * (physB->GetInverseMass() / totalMass)));
-
-	Vector3 relativeA = p.localA;
-	Vector3 relativeB = p.localB;
-
-	Vector3 angVelocityA = Vector::Cross(physA->GetAngularVelocity(), relativeA);
-	Vector3 angVelocityB = Vector::Cross(physB->GetAngularVelocity(), relativeB);
-
-	Vector3 fullVelocityA = physA->GetLinearVelocity() + angVelocityA;
-	Vector3 fullVelocityB = physB->GetLinearVelocity() + angVelocityB;
-
-	Vector3 contactVelocity = fullVelocityB - fullVelocityA;
-
-	float impulseForce = Vector::Dot(contactVelocity, p.normal);
+	SolverContact c;
+	c.physA		= physA;
+	c.physB		= physB;
+	c.relativeA	= p.localA;
+	c.relativeB	= p.localB;
+	c.normal	= p.normal;
+	c.pairIndex	= pairIndex;
+	c.friction	= std::sqrt(physA->GetFriction() * physB->GetFriction());
+
+	//Any two directions perpendicular to the normal will do for friction, as
+	//long as we pick the same ones each step so the warm start impulses match
+	Vector3 axis = (std::abs(c.normal.x) < 0.57f) ? Vector3(1, 0, 0) : Vector3(0, 1, 0);
+	c.tangents[0] = Vector::Normalise(Vector::Cross(c.normal, axis));
+	c.tangents[1] = Vector::Cross(c.normal, c.tangents[0]);
+
+	auto EffectiveMass = [&](const Vector3& dir) {
+		Vector3 inertiaA = Vector::Cross(physA->GetInertiaTensor() * Vector::Cross(c.relativeA, dir), c.relativeA);
+		Vector3 inertiaB = Vector::Cross(physB->GetInertiaTensor() * Vector::Cross(c.relativeB, dir), c.relativeB);
+		float angularEffect = Vector::Dot(inertiaA + inertiaB, dir);
+		return 1.0f / (totalMass + angularEffect);
+	};
+	c.normalMass		= EffectiveMass(c.normal);
+	c.tangentMass[0]	= EffectiveMass(c.tangents[0]);
+	c.tangentMass[1]	= EffectiveMass(c.tangents[1]);
+
+	Vector3 contactVelocity = (physB->GetLinearVelocity() + Vector::Cross(physB->GetAngularVelocity(), c.relativeB))
+							- (physA->GetLinearVelocity() + Vector::Cross(physA->GetAngularVelocity(), c.relativeA));
+	float normalVelocity = Vector::Dot(contactVelocity, c.normal);
+
+	float restitution	= physA->GetElasticity() * physB->GetElasticity();
+	float bounce		= (normalVelocity < -restitutionThreshold) ? -restitution * normalVelocity : 0.0f;
+	float push			= (contactBiasFactor / dt) * std::max(p.penetration - contactSlop, 0.0f);
+	c.targetVelocity	= std::max(bounce, push);
+
+	//Warm start - reapply what the closest of last step's points ended with
+	const CollisionPairCache::Entry& entry = allCollisions[pairIndex];
+	c.normalImpulse		= 0.0f;
+	c.tangentImpulse[0]	= 0.0f;
+	c.tangentImpulse[1]	= 0.0f;
+
+	float closest = warmStartMatchDistance * warmStartMatchDistance;
+	for (int i = 0; i < entry.impulseCount; ++i) {
+		float distance = Vector::LengthSquared(entry.impulses[i].localA - p.localA);
+		if (distance < closest) {
+			closest				= distance;
+			c.normalImpulse		= entry.impulses[i].normal;
+			c.tangentImpulse[0]	= entry.impulses[i].tangent[0];
+			c.tangentImpulse[1]	= entry.impulses[i].tangent[1];
+		}
+	}
 
-	Vector3 inertiaA = Vector::Cross(physA->GetInertiaTensor() * Vector::Cross(relativeA, p.normal), relativeA);
-	Vector3 inertiaB = Vector::Cross(physB->GetInertiaTensor() * Vector::Cross(relativeB, p.normal), relativeB);
-	float angularEffect = Vector::Dot(inertiaA + inertiaB, p.normal);
+	Vector3 impulse = c.normal * c.normalImpulse + c.tangents[0] * c.tangentImpulse[0] + c.tangents[1] * c.tangentImpulse[1];
+	physA->ApplyLinearImpulse(-impulse);
+	physB->ApplyLinearImpulse(impulse);
+	physA->ApplyAngularImpulse(Vector::Cross(c.relativeA, -impulse));
+	physB->ApplyAngularImpulse(Vector::Cross(c.relativeB, impulse));
 
-	float cRestitution = 0.66f;
+	solverContacts.push_back(c);
+}
 
-	float j = (-(1.0f + cRestitution) * impulseForce) / (totalMass + angularEffect);
+void PhysicsSystem::SolveContacts() {
+	for (SolverContact& c : solverContacts) {
+		PhysicsObject* physA = c.physA;
+		PhysicsObject* physB = c.physB;
+
+		auto ApplyImpulse = [&](const Vector3& impulse) {
+			physA->ApplyLinearImpulse(-impulse);
+			physB->ApplyLinearImpulse(impulse);
+			physA->ApplyAngularImpulse(Vector::Cross(c.relativeA, -impulse));
+			physB->ApplyAngularImpulse(Vector::Cross(c.relativeB, impulse));
+		};
+		auto ContactVelocity = [&]() {
+			return	(physB->GetLinearVelocity() + Vector::Cross(physB->GetAngularVelocity(), c.relativeB))
+				-	(physA->GetLinearVelocity() + Vector::Cross(physA->GetAngularVelocity(), c.relativeA));
+		};
+
+		//Friction can only push back as hard as the contact is pushing apart,
+		//in whichever direction along the surface it's pushing - so the two
+		//tangent impulses are clamped together, to a circle, not each on its own
+		float	maxFriction		= c.friction * c.normalImpulse;
+		Vector3 contactVelocity = ContactVelocity();
+		float	oldTangent[2]	= { c.tangentImpulse[0], c.tangentImpulse[1] };
+		for (int t = 0; t < 2; ++t) {
+			c.tangentImpulse[t] -= Vector::Dot(contactVelocity, c.tangents[t]) * c.tangentMass[t];
+		}
+		float frictionSq = c.tangentImpulse[0] * c.tangentImpulse[0] + c.tangentImpulse[1] * c.tangentImpulse[1];
+		if (frictionSq > maxFriction * maxFriction) {
+			float scale = maxFriction / std::sqrt(frictionSq);
+			c.tangentImpulse[0] *= scale;
+			c.tangentImpulse[1] *= scale;
+		}
+		ApplyImpulse(c.tangents[0] * (c.tangentImpulse[0] - oldTangent[0]) + c.tangents[1] * (c.tangentImpulse[1] - oldTangent[1]));
 
-	Vector3 fullImpulse = p.normal * j;
+		float normalVelocity	= Vector::Dot(ContactVelocity(), c.normal);
+		float lambda			= (c.targetVelocity - normalVelocity) * c.normalMass;
 
-	physA->ApplyLinearImpulse(-fullImpulse);
-	physB->ApplyLinearImpulse(fullImpulse);
+		float oldImpulse		= c.normalImpulse;
+		c.normalImpulse			= std::max(oldImpulse + lambda, 0.0f);
+		ApplyImpulse(c.normal * (c.normalImpulse - oldImpulse));
+	}
+}
 
-	physA->ApplyAngularImpulse(Vector::Cross(relativeA, -fullImpulse));
-	physB->ApplyAngularImpulse(Vector::Cross(relativeB, fullImpulse));
+/*
+Pairs that weren't touching this step shouldn't warm start from whatever
+they were doing the last time they were, so everything is zeroed first.
+*/
+void PhysicsSystem::StoreContactImpulses() {
+	for (CollisionPairCache::Entry& entry : allCollisions) {
+		entry.impulseCount = 0;
+	}
+	for (const SolverContact& c : solverContacts) {
+		CollisionPairCache::Entry& entry = allCollisions[c.pairIndex];
+		if (entry.impulseCount == CollisionDetection::MaxContactPoints) {
+			continue;
+		}
+		entry.impulses[entry.impulseCount++] = { c.relativeA, c.normalImpulse, { c.tangentImpulse[0], c.tangentImpulse[1] } };
+	}
 }
 
 /*
@@ -274,93 +631,463 @@ and a narrowphase collision detection method. In the broad phase, we
 split the world up using an acceleration structure, so that we can only
 compare the collisions that we absolutely need to. 
 
+Only objects that can move go into the broadphase structures below - pairs
+with static objects are found separately, against the GameWorld's static tree.
+
 */
 void PhysicsSystem::BroadPhase() {
-	broadphaseCollisions.clear();
+	broadphaseCollisionsVec.clear();
+
+	switch (broadPhaseType) {
+		case BroadPhaseType::QuadTree:		QuadTreeBroadPhase();		break;
+		case BroadPhaseType::AABBTree:		AABBTreeBroadPhase();		break;
+		case BroadPhaseType::SweepAndPrune:	SweepAndPruneBroadPhase();	break;
+	}
+	StaticBroadPhase();
+}
+
+void PhysicsSystem::QuadTreeBroadPhase() {
+	broadphasePairs.Clear();
 	QuadTree<GameObject*> tree(Vector2(1024, 1024), 7, 6);
 
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
-	for (auto i = first; i != last; ++i) {
-		Vector3 halfSizes;
-		if (!(*i)->GetBroadphaseAABB(halfSizes)) {
-			continue;
+	for (BodyType type : { BodyType::Kinematic, BodyType::Dynamic }) {
+		GameObjectIterator first;
+		GameObjectIterator last;
+		gameWorld.GetObjectIterators(type, first, last);
+		for (auto i = first; i != last; ++i) {
+			Vector3 halfSizes;
+			if (!(*i)->GetBroadphaseAABB(halfSizes)) {
+				continue;
+			}
+			Vector3 pos = (*i)->GetTransform().GetPosition();
+			tree.Insert(*i, pos, halfSizes);
 		}
-		Vector3 pos = (*i)->GetTransform().GetPosition();
-		tree.Insert(*i, pos, halfSizes);
 	}
 
 	tree.OperateOnContents([&](std::list<QuadTreeEntry<GameObject*>>& data) {
 		CollisionDetection::CollisionInfo info;
 		for (auto i = data.begin(); i != data.end(); ++i) {
 			for (auto j = std::next(i); j != data.end(); ++j) {
-				info.a = std::min((*i).object, (*j).object);
-				info.b = std::max((*i).object, (*j).object);
-				broadphaseCollisions.insert(info);
+				if (!IsCollidablePair((*i).object, (*j).object)) {
+					continue;
+				}
+				SetPairObjects(info, (*i).object, (*j).object);
+				//Objects can be in more than one leaf, so filter out duplicate pairs
+				bool isNew;
+				broadphasePairs.Add(info, isNew);
+				if (isNew) {
+					broadphaseCollisionsVec.push_back(info);
+				}
 			}
 		}
 		});
 }
 
 /*
+Whenever objects are added to or removed from the world, we have to add
+or remove their proxies in the persistent broadphase structures. This is
+the only time they do any work proportional to the total number of objects.
+*/
+template<class BroadPhaseStructure>
+static void SyncBroadPhaseProxies(const GameWorld& world, BroadPhaseStructure& structure, std::unordered_map<GameObject*, int>& proxies) {
+	std::unordered_map<GameObject*, int> newProxies;
+
+	for (BodyType type : { BodyType::Kinematic, BodyType::Dynamic }) {
+		GameObjectIterator first;
+		GameObjectIterator last;
+		world.GetObjectIterators(type, first, last);
+		for (auto i = first; i != last; ++i) {
+			Vector3 halfSizes;
+			if (!(*i)->GetBroadphaseAABB(halfSizes)) {
+				continue;
+			}
+			auto existing = proxies.find(*i);
+			if (existing != proxies.end()) {
+				newProxies.insert(*existing);
+				proxies.erase(existing);
+			}
+			else {
+				newProxies[*i] = structure.Insert(*i, (*i)->GetTransform().GetPosition(), halfSizes);
+			}
+		}
+	}
+	//Anything left over is no longer in the world, or no longer moves
+	for (auto& [object, proxy] : proxies) {
+		structure.Remove(proxy);
+	}
+	proxies = std::move(newProxies);
+}
 
-The broadphase will now only give us likely collisions, so we can now go through them,
-and work out if they are truly colliding, and if so, add them into the main collision list
+/*
+Unlike the QuadTree, the AABB tree persists across frames. Each step we
+only refit the leaves of objects that have moved outside of their fat
+bounds, and then let each awake dynamic object query the tree for overlaps.
+Pairs of inactive objects are never generated at all.
 */
-void PhysicsSystem::NarrowPhase() {
-	for (std::set<CollisionDetection::CollisionInfo>::iterator i = broadphaseCollisions.begin(); i != broadphaseCollisions.end(); ++i) {
-		CollisionDetection::CollisionInfo info = *i;
-		if (CollisionDetection::ObjectIntersection(info.a, info.b, info)) {
-			info.framesLeft = numCollisionFrames;
-			ImpulseResolveCollision(*info.a, *info.b, info.point);
-			allCollisions.insert(info);
+void PhysicsSystem::AABBTreeBroadPhase() {
+	if (treeWorldState != gameWorld.GetWorldStateID()) {
+		SyncBroadPhaseProxies(gameWorld, broadphaseTree, treeProxies);
+		treeWorldState = gameWorld.GetWorldStateID();
+	}
+	for (auto& [object, proxy] : treeProxies) {
+		if (IsAsleep(object)) {
+			continue;
 		}
+		Vector3 halfSizes;
+		object->GetBroadphaseAABB(halfSizes);
+		broadphaseTree.Update(proxy, object->GetTransform().GetPosition(), halfSizes);
+	}
+
+	CollisionDetection::CollisionInfo info;
+	for (auto& [object, proxy] : treeProxies) {
+		if (IsInactiveObject(object)) {
+			continue;
+		}
+		Vector3 halfSizes;
+		object->GetBroadphaseAABB(halfSizes);
+
+		broadphaseTree.Query(object->GetTransform().GetPosition(), halfSizes, [&](int otherProxy) {
+			GameObject* other = broadphaseTree.GetObject(otherProxy);
+			//Dynamic pairs will be found from both sides, so only keep one of them
+			if (other == object || (!IsInactiveObject(other) && other < object) || !object->CanCollideWith(*other)) {
+				return true;
+			}
+			SetPairObjects(info, object, other);
+			broadphaseCollisionsVec.push_back(info);
+			return true;
+		});
 	}
 }
 
 /*
-Integration of acceleration and velocity is split up, so that we can
-move objects multiple times during the course of a PhysicsUpdate,
-without worrying about repeated forces accumulating etc. 
+The sweep and prune structure keeps its sorted endpoint lists between
+frames, so all we need to do each step is hand it the latest bounds.
+*/
+void PhysicsSystem::SweepAndPruneBroadPhase() {
+	if (sapWorldState != gameWorld.GetWorldStateID()) {
+		SyncBroadPhaseProxies(gameWorld, sweepAndPrune, sapProxies);
+		sapWorldState = gameWorld.GetWorldStateID();
+	}
+	for (auto& [object, proxy] : sapProxies) {
+		if (IsAsleep(object)) {
+			continue;
+		}
+		Vector3 halfSizes;
+		object->GetBroadphaseAABB(halfSizes);
+		sweepAndPrune.Update(proxy, object->GetTransform().GetPosition(), halfSizes);
+	}
 
-This function will update both linear and angular acceleration,
-based on any forces that have been accumulated in the objects during
-the course of the previous game frame.
+	CollisionDetection::CollisionInfo info;
+	sweepAndPrune.FindPairs([&](GameObject* a, GameObject* b) {
+		if (!IsCollidablePair(a, b)) {
+			return;
+		}
+		SetPairObjects(info, a, b);
+		broadphaseCollisionsVec.push_back(info);
+	});
+}
+
+/*
+Static objects never move, so there's no point refitting them into the
+broadphase structures every step - instead, the GameWorld builds them a
+tree of their own when the level is loaded, and each awake dynamic object
+queries it. Kinematic objects can't be pushed by static ones, so they
+don't need to bother.
 */
-void PhysicsSystem::IntegrateAccel(float dt) {
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
+void PhysicsSystem::StaticBroadPhase() {
+	const AABBTree<GameObject*>& staticTree = gameWorld.GetStaticTree();
 
+	GameObjectIterator first;
+	GameObjectIterator last;
+	gameWorld.GetObjectIterators(BodyType::Dynamic, first, last);
+
+	CollisionDetection::CollisionInfo info;
 	for (auto i = first; i != last; ++i) {
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		if (object == nullptr) {
+		Vector3 halfSizes;
+		if (IsInactiveObject(*i) || !(*i)->GetBroadphaseAABB(halfSizes)) {
 			continue;
 		}
-		float inverseMass = object->GetInverseMass();
+		staticTree.Query((*i)->GetTransform().GetPosition(), halfSizes, [&](int proxy) {
+			GameObject* other = staticTree.GetObject(proxy);
+			if ((*i)->CanCollideWith(*other)) {
+				SetPairObjects(info, *i, other);
+				broadphaseCollisionsVec.push_back(info);
+			}
+			return true;
+		});
+	}
+}
 
-		Vector3 linearVel = object->GetLinearVelocity();
-		Vector3 force = object->GetForce();
-		Vector3 accel = force * inverseMass;
+/*
+Which order the broadphase finds its pairs in can depend on things like
+the layout of its hash maps, so in deterministic mode they're sorted by
+world ID before we go any further.
+*/
+void PhysicsSystem::SortBroadPhasePairs() {
+	std::sort(broadphaseCollisionsVec.begin(), broadphaseCollisionsVec.end(),
+		[](const CollisionDetection::CollisionInfo& x, const CollisionDetection::CollisionInfo& y) {
+			return CollisionPairCache::PairKey(x.a, x.b) < CollisionPairCache::PairKey(y.a, y.b);
+		}
+	);
+}
+
+/*
+
+The broadphase will now only give us likely collisions, so we can now go through them,
+and work out if they are truly colliding, and if so, add them into the main collision list
+
+The intersection tests only read from the objects, so the pairs are split into
+batches and tested across the worker pool, with each thread writing its contacts
+into its own buffer. Only once every pair has been tested do we go back to a
+single thread to resolve them.
+
+Pairs of spheres, and of AABBs and spheres, make up most of what gets this
+far, so they're sorted out of the rest and tested in batches, several pairs
+at a time, with SIMD kernels. Everything else goes through ObjectIntersection.
+
+Box tests start from whichever axis decided things between the pair last
+step, and GJK from the direction it last found between them - both are
+handed back out of every test (hit or not) so they can be remembered for
+the next one.
+*/
+void PhysicsSystem::NarrowPhase() {
+	threadContacts.resize(jobs.GetThreadCount());
+	for (std::vector<NarrowPhaseContact>& contacts : threadContacts) {
+		contacts.clear();
+	}
+	for (CollisionDetection::CollisionInfo& info : broadphaseCollisionsVec) {
+		auto i = separationCache.find(CollisionPairCache::PairKey(info.a, info.b));
+		if (i != separationCache.end()) {
+			info.cachedAxis			= i->second.axis;
+			info.cachedDirection	= i->second.direction;
+		}
+	}
+	SortPairsByType();
+
+	const NarrowPhaseKernels& kernels = GetNarrowPhaseKernels(GetSIMDLevel());
+	JobCounter batchesGathered;
+	RunContactBatch(sphereSphereBatch, kernels.sphereSphere, batchesGathered);
+	RunContactBatch(aabbSphereBatch, kernels.aabbSphere, batchesGathered);
+
+	jobs.ParallelFor(unbatchedPairs.size(), narrowPhaseBatchSize,
+		[&](size_t start, size_t end, unsigned int threadIndex) {
+			std::vector<NarrowPhaseContact>& contacts = threadContacts[threadIndex];
+			for (size_t j = start; j < end; ++j) {
+				size_t i = unbatchedPairs[j];
+				CollisionDetection::CollisionInfo info = broadphaseCollisionsVec[i];
+				if (CollisionDetection::ObjectIntersection(info.a, info.b, info)) {
+					contacts.push_back({ i, info });
+				}
+				broadphaseCollisionsVec[i].cachedAxis		= info.cachedAxis;
+				broadphaseCollisionsVec[i].cachedDirection	= info.cachedDirection;
+			}
+		}
+	);
+	jobs.Wait(batchesGathered);
 
-		if (applyGravity && inverseMass > 0) {
-			accel += gravity;
+	separationCache.clear();
+	for (const CollisionDetection::CollisionInfo& info : broadphaseCollisionsVec) {
+		if (info.cachedAxis >= 0 || Vector::LengthSquared(info.cachedDirection) > 0.0f) {
+			separationCache[CollisionPairCache::PairKey(info.a, info.b)] = { info.cachedAxis, info.cachedDirection };
 		}
+	}
+	ResolveNarrowPhaseContacts();
+}
 
-		linearVel += accel * dt;
-		object->SetLinearVelocity(linearVel);
+void PhysicsSystem::SortPairsByType() {
+	sphereSphereBatch.Clear();
+	aabbSphereBatch.Clear();
+	unbatchedPairs.clear();
 
-		Vector3 torque = object->GetTorque();
-		Vector3 angVel = object->GetAngularVelocity();
+	for (size_t i = 0; i < broadphaseCollisionsVec.size(); ++i) {
+		const CollisionDetection::CollisionInfo& info = broadphaseCollisionsVec[i];
+		const CollisionVolume* volA = info.a->GetBoundingVolume();
+		const CollisionVolume* volB = info.b->GetBoundingVolume();
+		if (!volA || !volB) {
+			continue;
+		}
+		Vector3 posA = info.a->GetTransform().GetPosition();
+		Vector3 posB = info.b->GetTransform().GetPosition();
 
-		object->UpdateInertiaTensor();
+		if (volA->type == VolumeType::Sphere && volB->type == VolumeType::Sphere) {
+			float radiusA = ((const SphereVolume*)volA)->GetRadius();
+			sphereSphereBatch.Add(i, false, posA, Vector3(radiusA, radiusA, radiusA), posB, ((const SphereVolume*)volB)->GetRadius());
+		}
+		else if (volA->type == VolumeType::AABB && volB->type == VolumeType::Sphere) {
+			aabbSphereBatch.Add(i, false, posA, ((const AABBVolume*)volA)->GetHalfDimensions(), posB, ((const SphereVolume*)volB)->GetRadius());
+		}
+		else if (volA->type == VolumeType::Sphere && volB->type == VolumeType::AABB) {
+			aabbSphereBatch.Add(i, true, posB, ((const AABBVolume*)volB)->GetHalfDimensions(), posA, ((const SphereVolume*)volA)->GetRadius());
+		}
+		else {
+			unbatchedPairs.push_back(i);
+		}
+	}
+}
 
-		Vector3 angAccel = object->GetInertiaTensor() * torque;
+void PhysicsSystem::ContactBatch::Clear() {
+	pairs.clear();
+	flipped.clear();
+	positionA.Clear();
+	extentA.Clear();
+	positionB.Clear();
+	radiusB.clear();
+	contacts.clear();
+}
 
-		angVel += angAccel * dt;
-		object->SetAngularVelocity(angVel);
+void PhysicsSystem::ContactBatch::Add(size_t pair, bool flip, const Vector3& posA, const Vector3& extA, const Vector3& posB, float radB) {
+	pairs.push_back(pair);
+	flipped.push_back(flip);
+	for (int i = 0; i < 3; ++i) {
+		positionA.c[i].push_back(posA[i]);
+		extentA.c[i].push_back(extA[i]);
+		positionB.c[i].push_back(posB[i]);
+	}
+	radiusB.push_back(radB);
+}
+
+ContactBatchArrays PhysicsSystem::ContactBatch::GetArrays() {
+	size_t count = pairs.size();
+	penetration.resize(count);
+	for (int i = 0; i < 3; ++i) {
+		normal.c[i].resize(count);
+		localA.c[i].resize(count);
+		localB.c[i].resize(count);
+	}
+	ContactBatchArrays a;
+	a.count = count;
+	for (int i = 0; i < 3; ++i) {
+		a.positionA[i]	= positionA.c[i].data();
+		a.extentA[i]	= extentA.c[i].data();
+		a.positionB[i]	= positionB.c[i].data();
+		a.normal[i]		= normal.c[i].data();
+		a.localA[i]		= localA.c[i].data();
+		a.localB[i]		= localB.c[i].data();
 	}
+	a.radiusB		= radiusB.data();
+	a.penetration	= penetration.data();
+	return a;
+}
+
+/*
+The kernels write a contact for every pair in the batch, and only those that
+are actually touching are turned into collisions. Each range of the batch is
+a job of its own, and gathering up the batch's contacts is queued to start
+once they've all finished - so the batches and the unbatched pairs are all
+tested at the same time, without anyone having to wait in between. The
+order contacts are added in doesn't matter, as they're all sorted back into
+pair order later.
+*/
+void PhysicsSystem::RunContactBatch(ContactBatch& batch, void (*kernel)(const ContactBatchArrays&, size_t, size_t), JobCounter& gathered) {
+	batch.arrays = batch.GetArrays();
+	for (size_t start = 0; start < batch.arrays.count; start += contactBatchSize) {
+		size_t end = std::min(start + contactBatchSize, batch.arrays.count);
+		jobs.Run([&batch, kernel, start, end] { kernel(batch.arrays, start, end); }, &batch.tested);
+	}
+	jobs.Run([this, &batch] { GatherBatchContacts(batch); }, &gathered, &batch.tested);
+}
+
+void PhysicsSystem::GatherBatchContacts(ContactBatch& batch) {
+	const ContactBatchArrays& arrays = batch.arrays;
+	for (size_t i = 0; i < arrays.count; ++i) {
+		if (!(batch.penetration[i] > 0.0f)) {
+			continue;
+		}
+		Vector3 normal(batch.normal.c[0][i], batch.normal.c[1][i], batch.normal.c[2][i]);
+		Vector3 localA(batch.localA.c[0][i], batch.localA.c[1][i], batch.localA.c[2][i]);
+		Vector3 localB(batch.localB.c[0][i], batch.localB.c[1][i], batch.localB.c[2][i]);
+
+		CollisionDetection::CollisionInfo info = broadphaseCollisionsVec[batch.pairs[i]];
+		info.pointCount = 0;
+		if (batch.flipped[i]) {
+			info.AddContactPoint(localB, localA, -normal, batch.penetration[i]);
+		}
+		else {
+			info.AddContactPoint(localA, localB, normal, batch.penetration[i]);
+		}
+		batch.contacts.push_back({ batch.pairs[i], info });
+	}
+}
+
+/*
+Which thread tested which batch changes from run to run, so the per-thread
+results are put back into broadphase pair order before we resolve anything -
+otherwise the order impulses are applied in (and so the simulation itself)
+would depend on thread scheduling.
+*/
+void PhysicsSystem::ResolveNarrowPhaseContacts() {
+	narrowPhaseContacts.clear();
+	for (const std::vector<NarrowPhaseContact>& contacts : threadContacts) {
+		narrowPhaseContacts.insert(narrowPhaseContacts.end(), contacts.begin(), contacts.end());
+	}
+	for (const ContactBatch* batch : { &sphereSphereBatch, &aabbSphereBatch }) {
+		narrowPhaseContacts.insert(narrowPhaseContacts.end(), batch->contacts.begin(), batch->contacts.end());
+	}
+	std::sort(narrowPhaseContacts.begin(), narrowPhaseContacts.end(),
+		[](const NarrowPhaseContact& a, const NarrowPhaseContact& b) {
+			return a.pairIndex < b.pairIndex;
+		}
+	);
+	for (NarrowPhaseContact& c : narrowPhaseContacts) {
+		AddContact(c.info);
+	}
+}
+
+//Trigger pairs are only recorded, so that they get their begin and end events
+void PhysicsSystem::AddContact(const CollisionDetection::CollisionInfo& info) {
+	size_t pairIndex = AddCollision(info);
+	if (!info.a->IsTrigger() && !info.b->IsTrigger()) {
+		AddSolverContact(info, pairIndex, realDT);
+	}
+}
+
+/*
+A 64 bit FNV-1a hash of the raw bits of every moving body's state, so even
+the smallest difference between two runs changes it. Static objects can't
+change, so there's no point including them.
+*/
+static void HashBytes(uint64_t& hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+}
+
+uint64_t PhysicsSystem::HashState() const {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (BodyType type : { BodyType::Kinematic, BodyType::Dynamic }) {
+		GameObjectIterator first;
+		GameObjectIterator last;
+		gameWorld.GetObjectIterators(type, first, last);
+		for (auto i = first; i != last; ++i) {
+			const PhysicsObject* phys = (*i)->GetPhysicsObject();
+			Transform& transform = (*i)->GetTransform();
+
+			int			id		= (*i)->GetWorldID();
+			Vector3		state[3] = { transform.GetPosition(), phys->GetLinearVelocity(), phys->GetAngularVelocity() };
+			Quaternion	rot		= transform.GetOrientation();
+
+			HashBytes(hash, &id, sizeof(id));
+			HashBytes(hash, state, sizeof(state));
+			HashBytes(hash, &rot, sizeof(rot));
+		}
+	}
+	return hash;
+}
+
+/*
+Integration of acceleration and velocity is split up, so that we can
+move objects multiple times during the course of a PhysicsUpdate,
+without worrying about repeated forces accumulating etc. 
+
+This function will update both linear and angular acceleration,
+based on any forces that have been accumulated in the objects during
+the course of the previous game frame.
+*/
+void PhysicsSystem::IntegrateAccel(float dt) {
+	bodies.IntegrateAccel(dt, gravity, applyGravity);
 }
 
 /*
@@ -368,38 +1095,117 @@ This function integrates linear and angular velocity into
 position and orientation. It may be called multiple times
 throughout a physics update, to slowly move the objects through
 the world, looking for collisions.
+
+The collision detection works on the Transforms, so they're
+updated with the results straight away.
 */
 void PhysicsSystem::IntegrateVelocity(float dt) {
-	std::vector<GameObject*>::const_iterator first;
-	std::vector<GameObject*>::const_iterator last;
-	gameWorld.GetObjectIterators(first, last);
-	float frameLinearDamping = 1.0f - (0.4f * dt);
+	float frameLinearDamping	= 1.0f - (0.4f * dt);
+	float frameAngularDamping	= 1.0f - (0.4f * dt);
 
-	for (auto i = first; i != last; ++i) {
-		PhysicsObject* object = (*i)->GetPhysicsObject();
-		if (object == nullptr) {
+	bodies.IntegrateVelocity(dt, frameLinearDamping, frameAngularDamping);
+	bodies.StoreTransforms();
+}
+
+/*
+Fast moving objects could move further in a single step than the thickness
+of whatever's in their way, and skip straight through it without the
+discrete tests ever seeing them touch. So, we note where they started the
+step, and once they've been moved, sweep them along the path they took.
+If they'd have hit something along the way, they're put back to where they
+first touched it (leaving them just overlapping it, so that the next step's
+collision detection can bounce them off it). Whatever's left of the step's
+movement is simply lost - it's only ever a fraction of a step's worth.
+*/
+void PhysicsSystem::BeginContinuousCollision() {
+	sweepStarts.resize(fastObjects.size());
+	for (size_t i = 0; i < fastObjects.size(); ++i) {
+		sweepStarts[i] = fastObjects[i]->GetTransform().GetPosition();
+	}
+}
+
+void PhysicsSystem::ResolveContinuousCollision(float dt) {
+	for (size_t i = 0; i < fastObjects.size(); ++i) {
+		GameObject*		object	= fastObjects[i];
+		PhysicsObject*	phys	= object->GetPhysicsObject();
+		if (phys->IsAsleep() || object->IsTrigger()) {
+			continue; //Triggers pass through things anyway
+		}
+		Vector3 start	= sweepStarts[i];
+		Vector3 end		= object->GetTransform().GetPosition();
+
+		//Slower than this, and the discrete tests will catch it overlapping first
+		float radius = CollisionDetection::VolumeInnerRadius(*object->GetBoundingVolume());
+		if (Vector::Length(end - start) <= radius) {
 			continue;
 		}
-		Transform& transform = (*i)->GetTransform();
-		Vector3 position = transform.GetPosition();
-		Vector3 linearVel = object->GetLinearVelocity();
-		position += linearVel * dt;
-		transform.SetPosition(position);
-		linearVel = linearVel * frameLinearDamping;
-		object->SetLinearVelocity(linearVel);
+		float timeOfImpact = SweepFastObject(object, start, end, dt);
+		if (timeOfImpact < 1.0f) {
+			Vector3 impactPos = start + (end - start) * timeOfImpact;
+			object->GetTransform().SetPosition(impactPos);
+			bodies.SetPosition(phys->GetBodyHandle(), impactPos);
+		}
+	}
+}
 
-		Quaternion orientation = transform.GetOrientation();
-		Vector3 angVel = object->GetAngularVelocity();
+/*
+Static objects are looked up in the GameWorld's static tree, and can be
+swept against directly. Kinematic objects might be moving too, so they're
+tested using conservative advancement, which can handle that. We don't try
+to stop fast objects passing through each other.
+*/
+float PhysicsSystem::SweepFastObject(GameObject* object, const Vector3& start, const Vector3& end, float dt) {
+	float radius		= CollisionDetection::VolumeInnerRadius(*object->GetBoundingVolume()) - sweepPenetration;
+	float firstImpact	= 1.0f;
+
+	Vector3 motion		= end - start;
+	Vector3 sweepPos	= (start + end) * 0.5f;
+	Vector3 sweepSize	= Vector3(std::abs(motion.x), std::abs(motion.y), std::abs(motion.z)) * 0.5f + Vector3(radius, radius, radius);
+
+	const AABBTree<GameObject*>& staticTree = gameWorld.GetStaticTree();
+	staticTree.Query(sweepPos, sweepSize, [&](int proxy) {
+		GameObject* other = staticTree.GetObject(proxy);
+		if (other->IsTrigger() || !object->CanCollideWith(*other)) {
+			return true;
+		}
+		float timeOfImpact;
+		if (CollisionDetection::SweptSphereIntersection(radius, start, end, *other->GetBoundingVolume(), other->GetTransform(), timeOfImpact)) {
+			firstImpact = std::min(firstImpact, timeOfImpact);
+		}
+		return true;
+	});
 
-		orientation = orientation + (Quaternion(angVel * dt * 0.5f, 0.0f) * orientation);
+	GameObjectIterator first;
+	GameObjectIterator last;
+	gameWorld.GetObjectIterators(BodyType::Kinematic, first, last);
+	for (auto i = first; i != last; ++i) {
+		Vector3 halfSizes;
+		if (!(*i)->GetBroadphaseAABB(halfSizes) || (*i)->IsTrigger() || !object->CanCollideWith(**i)) {
+			continue;
+		}
+		const PhysicsObject* phys		= (*i)->GetPhysicsObject();
+		Vector3			linearMotion	= phys->GetLinearVelocity() * dt;
+		Vector3			angularMotion	= phys->GetAngularVelocity() * dt;
+		Transform		otherStart		= (*i)->GetTransform();
+
+		//It's already been moved this step, so wind it back to where it started
+		Quaternion orientation = otherStart.GetOrientation();
+		orientation = orientation - (Quaternion(angularMotion * 0.5f, 0.0f) * orientation);
 		orientation.Normalise();
+		otherStart.SetPosition(otherStart.GetPosition() - linearMotion);
+		otherStart.SetOrientation(orientation);
 
-		transform.SetOrientation(orientation);
-
-		float frameAngularDamping = 1.0f - (0.4f * dt);
-		angVel = angVel * frameAngularDamping;
-		object->SetAngularVelocity(angVel);
+		Vector3 reach = halfSizes + Vector3(std::abs(linearMotion.x), std::abs(linearMotion.y), std::abs(linearMotion.z));
+		if (!CollisionDetection::AABBTest(sweepPos, (*i)->GetTransform().GetPosition(), sweepSize, reach)) {
+			continue;
+		}
+		float timeOfImpact;
+		if (CollisionDetection::ConservativeAdvancement(radius, start, end, *(*i)->GetBoundingVolume(), otherStart,
+			linearMotion, angularMotion, timeOfImpact)) {
+			firstImpact = std::min(firstImpact, timeOfImpact);
+		}
 	}
+	return firstImpact;
 }
 
 /*
@@ -408,11 +1214,45 @@ clear out any accumulated forces, ready to receive new
 ones in the next 'game' frame.
 */
 void PhysicsSystem::ClearForces() {
-	gameWorld.OperateOnContents(
-		[](GameObject* o) {
-			o->GetPhysicsObject()->ClearForces();
+	bodies.ClearForces();
+}
+
+/*
+Every object in the world that can move has its state moved into our
+RigidBodyStore, so that the integrators can work on it as one big batch.
+Static objects are left out entirely, so they're never integrated or have
+their forces cleared. As with the broadphase proxies, we only need to check
+this when objects have been added to or removed from the world.
+*/
+void PhysicsSystem::SyncRigidBodies() {
+	if (bodyWorldState == gameWorld.GetWorldStateID()) {
+		return;
+	}
+	bodyWorldState = gameWorld.GetWorldStateID();
+
+	std::unordered_set<PhysicsObject*> inWorld;
+	fastObjects.clear();
+	for (BodyType type : { BodyType::Kinematic, BodyType::Dynamic }) {
+		GameObjectIterator first;
+		GameObjectIterator last;
+		gameWorld.GetObjectIterators(type, first, last);
+		for (auto i = first; i != last; ++i) {
+			PhysicsObject* object = (*i)->GetPhysicsObject();
+			inWorld.insert(object);
+			object->AttachToStore(&bodies);
+
+			if (type == BodyType::Dynamic && object->IsFastMoving() && (*i)->GetBoundingVolume()) {
+				fastObjects.emplace_back(*i);
+			}
 		}
-	);
+	}
+	//Detaching swaps the last body into the gap, so walk backwards
+	for (size_t i = bodies.Size(); i > 0; --i) {
+		PhysicsObject* object = bodies.GetOwner(i - 1);
+		if (!inWorld.contains(object)) {
+			object->DetachFromStore();
+		}
+	}
 }
 
 
@@ -429,6 +1269,124 @@ void PhysicsSystem::UpdateConstraints(float dt) {
 	gameWorld.GetConstraintIterators(first, last);
 
 	for (auto i = first; i != last; ++i) {
+		GameObject* a = (*i)->GetObjectA();
+		GameObject* b = (*i)->GetObjectB();
+		//Anything tied to an awake object will have been woken up along with it
+		if (a && b && IsInactiveObject(a) && IsInactiveObject(b)) {
+			continue;
+		}
 		(*i)->UpdateConstraint(dt);
 	}
-}
\ No newline at end of file
+}
+
+/*
+Objects that are touching, or tied together by a constraint, form an
+island - if any object in an island is awake, then all of them have to be,
+as whatever is going on in the awake one can push the others around.
+Islands are found with a union-find over body handles, linking the two
+bodies of every contact and constraint. Static objects don't join islands,
+otherwise everything resting on the floor would be one big island - and
+neither do kinematic ones, but a moving kinematic object does wake up
+whatever it touches, which then wakes the rest of its island.
+*/
+int PhysicsSystem::FindIsland(int handle) {
+	while (islandParent[handle] != handle) {
+		islandParent[handle] = islandParent[islandParent[handle]]; //Path halving
+		handle = islandParent[handle];
+	}
+	return handle;
+}
+
+void PhysicsSystem::LinkIsland(const PhysicsObject* a, const PhysicsObject* b) {
+	if (!a || !b || a->GetBodyStore() != &bodies || b->GetBodyStore() != &bodies) {
+		return;
+	}
+	if (a->GetInverseMass() == 0.0f || b->GetInverseMass() == 0.0f) {
+		return;
+	}
+	int rootA = FindIsland(a->GetBodyHandle());
+	int rootB = FindIsland(b->GetBodyHandle());
+	if (rootA != rootB) {
+		islandParent[rootB] = rootA;
+	}
+}
+
+void PhysicsSystem::WakeByKinematic(const PhysicsObject* kinematic, const PhysicsObject* other) {
+	if (!kinematic || !other || !kinematic->IsKinematic() || kinematic->IsAsleep()) {
+		return;
+	}
+	if (other->GetBodyStore() == &bodies && other->GetInverseMass() > 0.0f && other->IsAsleep()) {
+		bodies.SetAwake(other->GetBodyHandle(), true);
+	}
+}
+
+void PhysicsSystem::UpdateIslands() {
+	size_t handleLimit = bodies.GetHandleLimit();
+	islandParent.resize(handleLimit);
+	for (size_t i = 0; i < handleLimit; ++i) {
+		islandParent[i] = (int)i;
+	}
+
+	for (const SolverContact& c : solverContacts) {
+		LinkIsland(c.physA, c.physB);
+		WakeByKinematic(c.physA, c.physB);
+		WakeByKinematic(c.physB, c.physA);
+	}
+
+	std::vector<Constraint*>::const_iterator first;
+	std::vector<Constraint*>::const_iterator last;
+	gameWorld.GetConstraintIterators(first, last);
+	for (auto i = first; i != last; ++i) {
+		GameObject* a = (*i)->GetObjectA();
+		GameObject* b = (*i)->GetObjectB();
+		if (a && b) {
+			LinkIsland(a->GetPhysicsObject(), b->GetPhysicsObject());
+		}
+	}
+
+	//Wake up every sleeping body that shares an island with an awake one
+	islandFlags.assign(handleLimit, 0);
+	for (size_t i = 0; i < bodies.GetAwakeCount(); ++i) {
+		islandFlags[FindIsland(bodies.GetHandle(i))] = 1;
+	}
+	islandHandles.clear();
+	for (size_t i = bodies.GetAwakeCount(); i < bodies.Size(); ++i) {
+		int handle = bodies.GetHandle(i);
+		if (islandFlags[FindIsland(handle)]) {
+			islandHandles.push_back(handle);
+		}
+	}
+	for (int handle : islandHandles) {
+		bodies.SetAwake(handle, true);
+	}
+}
+
+/*
+An island only goes to sleep once every body in it has been moving slowly
+for long enough - putting half of a stack to sleep would leave the other
+half resting on something that won't push back.
+*/
+void PhysicsSystem::UpdateSleeping(float dt) {
+	if (!useSleeping) {
+		return;
+	}
+	bodies.UpdateSleepTimes(dt, sleepLinearThreshold, sleepAngularThreshold);
+
+	size_t handleLimit = bodies.GetHandleLimit();
+	islandSleepTime.assign(handleLimit, FLT_MAX);
+	for (size_t i = 0; i < bodies.GetAwakeCount(); ++i) {
+		int handle	= bodies.GetHandle(i);
+		int root	= FindIsland(handle);
+		islandSleepTime[root] = std::min(islandSleepTime[root], bodies.GetSleepTime(handle));
+	}
+	islandHandles.clear();
+	for (size_t i = 0; i < bodies.GetAwakeCount(); ++i) {
+		int handle = bodies.GetHandle(i);
+		if (islandSleepTime[FindIsland(handle)] >= timeToSleep) {
+			islandHandles.push_back(handle);
+		}
+	}
+	for (int handle : islandHandles) {
+		bodies.SetAwake(handle, false);
+	}
+}
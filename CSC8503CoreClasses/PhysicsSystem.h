@@ -1,42 +1,258 @@
 #pragma once
 #include "GameWorld.h"
+#include "AABBTree.h"
+#include "SweepAndPrune.h"
+#include "CollisionPairCache.h"
+#include "JobSystem.h"
+#include "RigidBodyStore.h"
+#include "NarrowPhaseKernels.h"
+#include "PhysicsReplay.h"
+#include <unordered_map>
 
 namespace NCL {
 	namespace CSC8503 {
+		enum class BroadPhaseType {
+			QuadTree,
+			AABBTree,
+			SweepAndPrune
+		};
+
+		/*
+		Something that happened to a collision pair during a physics update.
+		Begin and End are sent once, when a pair starts and stops touching,
+		and Stay is sent every update in between. The normal and point come
+		from the pair's first contact point, with the normal pointing from a
+		to b.
+		*/
+		struct CollisionEvent {
+			enum class Type {
+				Begin,
+				Stay,
+				End
+			};
+			Type		type;
+			GameObject* a;
+			GameObject* b;
+			Vector3		normal;
+			Vector3		point;		//World space
+			bool		isTrigger;	//Either object is a trigger, so nothing was pushed apart
+		};
+
 		class PhysicsSystem	{
 		public:
-			PhysicsSystem(GameWorld& g);
+			//The narrowphase, contact kernels and integrators share their work out as jobs
+			PhysicsSystem(GameWorld& g, JobSystem& jobs = JobSystem::GetShared());
 			~PhysicsSystem();
 
 			void Clear();
 
 			void Update(float dt);
 
-			void UseGravity(bool state) {
-				applyGravity = state;
+			/*
+			Rather than calling into the game while it's in the middle of going
+			through its collision pairs, each update fills a buffer of collision
+			events, which the game can look through once the update has finished.
+			The buffer is emptied at the start of the next update, so any
+			pointers in it are only good until then.
+			*/
+			const std::vector<CollisionEvent>& GetCollisionEvents() const {
+				return collisionEvents;
 			}
 
+			/*
+			Copies the events involving the given object (or any object, if it's
+			null) into results, turned around so that the object is always a, and
+			returns how many were copied. Only events whose other object is on
+			one of the given layers are counted - if there's no object, either
+			object will do.
+			*/
+			size_t GetCollisionEvents(const GameObject* object, uint32_t layerMask, CollisionEvent* results, size_t maxResults) const;
+
+			//Calls every Begin and End event's OnCollisionBegin / OnCollisionEnd functions
+			void DispatchCollisionEvents() const;
+
+			void UseGravity(bool state);
+
+			//Whether resting objects are allowed to go to sleep
+			void SetSleeping(bool state);
+
 			void SetGlobalDamping(float d) {
 				globalDamping = d;
 			}
 
 			void SetGravity(const Vector3& g);
+
+			//Without the broadphase, every pair of objects is tested against each other
+			void UseBroadPhase(bool state) {
+				useBroadPhase = state;
+			}
+
+			bool IsUsingBroadPhase() const {
+				return useBroadPhase;
+			}
+
+			void SetBroadPhase(BroadPhaseType type) {
+				broadPhaseType = type;
+			}
+
+			BroadPhaseType GetBroadPhase() const {
+				return broadPhaseType;
+			}
+
+			//Which instruction set the integrators use - the results are the same whichever we pick
+			void SetSIMDLevel(SIMDLevel level) {
+				bodies.SetSIMDLevel(level);
+			}
+
+			SIMDLevel GetSIMDLevel() const {
+				return bodies.GetSIMDLevel();
+			}
+
+			/*
+			In deterministic mode every step is exactly idealDT long, however
+			long the steps take to run, collision pairs are put into a fixed
+			order before they're solved, and the world's shuffles are seeded.
+			Given the same starting state and the same inputs, two runs will
+			then match bit for bit, which we check by hashing the state of
+			every body at the end of every step.
+			*/
+			void SetDeterministic(bool state, unsigned int seed = 0);
+
+			bool IsDeterministic() const {
+				return deterministic;
+			}
+
+			//The hash of the world at the end of the last deterministic step
+			uint64_t GetStateHash() const {
+				return stateHash;
+			}
+
+			uint64_t GetStepCount() const {
+				return stepCount;
+			}
+
+			//Records or validates every deterministic step, if set
+			void SetReplay(PhysicsReplay* r) {
+				replay = r;
+			}
+
+			/*
+			The physics runs in fixed steps, which hardly ever line up with the
+			frames being drawn, so moving objects can look like they stutter.
+			With interpolation on, bodies are instead drawn between where they
+			were at the start and the end of the latest step, however far
+			through the next step the leftover time has got to. This puts what
+			you see up to a step behind the simulation, but never changes the
+			simulation itself - only the matrices handed to the renderer.
+			*/
+			void SetInterpolation(bool state) {
+				interpolate = state;
+			}
+
+			bool IsInterpolating() const {
+				return interpolate;
+			}
+
+			//How far through the next step the leftover time is, from 0 to 1
+			float GetInterpolationAlpha() const;
+
+			//Where the object should be drawn, which is just its transform if we're not interpolating
+			Matrix4 GetRenderMatrix(const GameObject& object) const;
+
+			//Hands every moving object's render matrix over to its RenderObject
+			void UpdateRenderTransforms();
+
+			/*
+			Outside of deterministic mode, the step rate adapts to how long the
+			steps are taking. We keep a smoothed average of what a step costs,
+			and if the steps a frame needs would take more than the budget, the
+			rate is halved - and it's only doubled again once there's plenty of
+			room for twice as many steps. Rates are only changed every so often,
+			so one slow frame can't make it flip back and forth.
+
+			However slow things get, one update never runs more than the
+			maximum number of steps - any time left over beyond that is
+			dropped, rather than piling up and making the next update slower
+			still. Deterministic runs never drop time.
+			*/
+			void SetStepBudget(float seconds) {
+				stepBudget = seconds;
+			}
+
+			float GetStepBudget() const {
+				return stepBudget;
+			}
+
+			void SetMaxSubsteps(int steps) {
+				maxSubsteps = steps;
+			}
+
+			int GetMaxSubsteps() const {
+				return maxSubsteps;
+			}
+
+			//How many steps a second we're running at now
+			int GetStepRate() const {
+				return realHZ;
+			}
+
+			//The smoothed cost of a step, in seconds
+			float GetAverageStepTime() const {
+				return averageStepTime;
+			}
+
+			void SetConstraintIterationCount(int count) {
+				constraintIterationCount = count;
+			}
+
+			int GetConstraintIterationCount() const {
+				return constraintIterationCount;
+			}
 		protected:
 			void BasicCollisionDetection();
 			void BroadPhase();
+			void QuadTreeBroadPhase();
+			void AABBTreeBroadPhase();
+			void SweepAndPruneBroadPhase();
+			void StaticBroadPhase();
+			void SortBroadPhasePairs();
 			void NarrowPhase();
+			void SortPairsByType();
+			void ResolveNarrowPhaseContacts();
 
 			void ClearForces();
+			void SyncRigidBodies();
+
+			void UpdateIslands();
+			void UpdateSleeping(float dt);
+			int  FindIsland(int handle);
+			void LinkIsland(const PhysicsObject* a, const PhysicsObject* b);
+			void WakeByKinematic(const PhysicsObject* kinematic, const PhysicsObject* other);
 
 			void IntegrateAccel(float dt);
 			void IntegrateVelocity(float dt);
 
+			void SetStepRate(int hz);
+			void UpdateStepRate(float dt, float updateTime, int stepsTaken);
+
+			void BeginContinuousCollision();
+			void ResolveContinuousCollision(float dt);
+			float SweepFastObject(GameObject* object, const Vector3& start, const Vector3& end, float dt);
+
 			void UpdateConstraints(float dt);
 
 			void UpdateCollisionList();
+			size_t AddCollision(const CollisionDetection::CollisionInfo& info);
+			void AddCollisionEvent(CollisionEvent::Type type, const CollisionDetection::CollisionInfo& info);
+			void AddContact(const CollisionDetection::CollisionInfo& info);
 			void UpdateObjectAABBs();
 
-			void ImpulseResolveCollision(GameObject& a , GameObject&b, CollisionDetection::ContactPoint& p) const;
+			void AddSolverContact(const CollisionDetection::CollisionInfo& info, size_t pairIndex, float dt);
+			void AddSolverContact(const CollisionDetection::CollisionInfo& info, const CollisionDetection::ContactPoint& p, size_t pairIndex, float dt);
+			void SolveContacts();
+			void StoreContactImpulses();
+
+			uint64_t HashState() const;
 
 			GameWorld& gameWorld;
 
@@ -44,12 +260,136 @@ namespace NCL {
 			Vector3 gravity;
 			float	dTOffset;
 			float	globalDamping;
+			bool	interpolate;
+
+			int		realHZ;
+			float	realDT;
+			float	stepBudget;
+			int		maxSubsteps;
+			float	averageStepTime;	//Both 0 until we've had a sample
+			float	averageFrameTime;
+			int		stepRateCooldown;	//Updates until we're allowed to change the rate again
+			int		constraintIterationCount;
+
+			bool			deterministic;
+			uint64_t		stateHash;
+			uint64_t		stepCount;
+			PhysicsReplay*	replay;
 
-			std::set<CollisionDetection::CollisionInfo> allCollisions;
-			std::set<CollisionDetection::CollisionInfo> broadphaseCollisions;
+			CollisionPairCache allCollisions;
+			std::vector<CollisionEvent> collisionEvents;
+			CollisionPairCache broadphasePairs;
 			std::vector<CollisionDetection::CollisionInfo> broadphaseCollisionsVec;
+
+			//What each pair's narrowphase test ended on last step, so the next
+			//test can start from there
+			struct SeparationCache {
+				int		axis;
+				Vector3	direction;
+			};
+			std::unordered_map<uint64_t, SeparationCache> separationCache;
 			bool useBroadPhase		= true;
 			int numCollisionFrames	= 5;
+
+			BroadPhaseType broadPhaseType = BroadPhaseType::QuadTree;
+
+			AABBTree<GameObject*>				broadphaseTree;
+			std::unordered_map<GameObject*, int>	treeProxies;
+			int									treeWorldState = -1;
+
+			SweepAndPrune<GameObject*>			sweepAndPrune;
+			std::unordered_map<GameObject*, int>	sapProxies;
+			int									sapWorldState = -1;
+
+			//A contact found by the narrowphase, tagged with the index of the
+			//broadphase pair it came from so the threads' results can be merged
+			//back into a fixed order
+			struct NarrowPhaseContact {
+				size_t								pairIndex;
+				CollisionDetection::CollisionInfo	info;
+			};
+
+			/*
+			A contact in the form the solver wants it - everything that stays
+			the same across solver iterations is worked out up front.
+			*/
+			struct SolverContact {
+				PhysicsObject*	physA;
+				PhysicsObject*	physB;
+				Vector3			relativeA;
+				Vector3			relativeB;
+				Vector3			normal;
+				Vector3			tangents[2];
+
+				float			normalMass;
+				float			tangentMass[2];
+				float			targetVelocity;	//Separating speed we're aiming for along the normal
+				float			friction;
+
+				float			normalImpulse;
+				float			tangentImpulse[2];
+
+				size_t			pairIndex;		//Where to store the impulses for warm starting
+			};
+			std::vector<SolverContact>	solverContacts;
+
+			RigidBodyStore	bodies;
+			int				bodyWorldState = -1;
+
+			bool	useSleeping				= true;
+			float	sleepLinearThreshold	= 0.1f;
+			float	sleepAngularThreshold	= 0.1f;
+			float	timeToSleep				= 0.5f;	//Seconds an island has to stay slow before sleeping
+
+			std::vector<int>	islandParent;		//Union-find, indexed by body handle
+			std::vector<char>	islandFlags;
+			std::vector<float>	islandSleepTime;
+			std::vector<int>	islandHandles;
+
+			std::vector<GameObject*>	fastObjects;
+			std::vector<Vector3>		sweepStarts;
+			float						sweepPenetration = 0.005f; //Left overlapping by this much, so the discrete tests see the contact
+
+			JobSystem&										jobs;
+			std::vector<std::vector<NarrowPhaseContact>>	threadContacts;
+			std::vector<NarrowPhaseContact>					narrowPhaseContacts;
+			size_t											narrowPhaseBatchSize = 64;
+			size_t											aabbBatchSize = 256;
+
+			/*
+			Pairs of volume types common enough to be worth testing in batches,
+			gathered into the arrays the batched kernels work on. Volume B is
+			always the sphere, so pairs where the sphere was a are flipped, and
+			their contacts turned back around afterwards.
+			*/
+			struct ContactBatch {
+				std::vector<size_t>	pairs;		//Indices into broadphaseCollisionsVec
+				std::vector<char>	flipped;
+				FloatStreams<3>		positionA;
+				FloatStreams<3>		extentA;
+				FloatStreams<3>		positionB;
+				std::vector<float>	radiusB;
+
+				FloatStreams<3>		normal;
+				std::vector<float>	penetration;
+				FloatStreams<3>		localA;
+				FloatStreams<3>		localB;
+
+				ContactBatchArrays				arrays = {};
+				JobCounter						tested;
+				std::vector<NarrowPhaseContact>	contacts;
+
+				void Clear();
+				void Add(size_t pair, bool flip, const Vector3& posA, const Vector3& extA, const Vector3& posB, float radB);
+				ContactBatchArrays GetArrays();
+			};
+			void RunContactBatch(ContactBatch& batch, void (*kernel)(const ContactBatchArrays&, size_t, size_t), JobCounter& gathered);
+			void GatherBatchContacts(ContactBatch& batch);
+
+			ContactBatch		sphereSphereBatch;
+			ContactBatch		aabbSphereBatch;
+			std::vector<size_t>	unbatchedPairs;
+			size_t				contactBatchSize = 256;
 		};
 	}
 }
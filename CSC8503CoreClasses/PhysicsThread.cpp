@@ -0,0 +1,145 @@
+#include "PhysicsThread.h"
+#include "PhysicsSystem.h"
+#include "PhysicsObject.h"
+#include "GameWorld.h"
+#include "GameObject.h"
+#include "RenderObject.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+PhysicsThread::PhysicsThread(PhysicsSystem& p, GameWorld& w) : physics(p), world(w) {
+	updateDT			= 0.0f;
+	busy				= false;
+	shuttingDown		= false;
+	backSnapshot		= 0;
+	snapshotWorldState	= -1;
+	thread = std::thread(&PhysicsThread::ThreadLoop, this);
+}
+
+PhysicsThread::~PhysicsThread() {
+	Finish();
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		shuttingDown = true;
+	}
+	updateStarted.notify_one();
+	thread.join();
+}
+
+void PhysicsThread::ThreadLoop() {
+	std::unique_lock<std::mutex> lock(stateMutex);
+	while (true) {
+		updateStarted.wait(lock, [&] { return busy || shuttingDown; });
+		if (shuttingDown) {
+			return;
+		}
+		float dt = updateDT;
+		lock.unlock();
+
+		physics.Update(dt);
+		TakeSnapshot(snapshots[backSnapshot]);
+
+		lock.lock();
+		busy = false;
+		updateFinished.notify_one();
+	}
+}
+
+/*
+Anything that was added to or removed from the world since the last update
+hasn't got a snapshot yet (or has one it shouldn't), so in that case we have
+to take one ourselves before the physics thread can start moving things.
+*/
+void PhysicsThread::Begin(float dt) {
+	Finish();
+	RunCommands();
+
+	world.UpdatePartitions();
+	if (snapshotWorldState != world.GetWorldStateID()) {
+		TakeSnapshot(snapshots[backSnapshot]);
+		ApplySnapshot(snapshots[backSnapshot]);
+		snapshotWorldState = world.GetWorldStateID();
+	}
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		updateDT	= dt;
+		busy		= true;
+	}
+	updateStarted.notify_one();
+}
+
+void PhysicsThread::Finish() {
+	{
+		std::unique_lock<std::mutex> lock(stateMutex);
+		if (!busy && snapshots[backSnapshot].empty()) {
+			return;
+		}
+		updateFinished.wait(lock, [&] { return !busy; });
+	}
+	int frontSnapshot	= backSnapshot;
+	backSnapshot		= 1 - backSnapshot;
+	ApplySnapshot(snapshots[frontSnapshot]);
+	snapshots[frontSnapshot].clear();
+}
+
+void PhysicsThread::ClearSnapshots() {
+	Finish();
+	world.OperateOnContents([](GameObject* o) {
+		if (RenderObject* r = o->GetRenderObject()) {
+			r->ClearSnapshot();
+		}
+	});
+	snapshotWorldState = -1;
+}
+
+void PhysicsThread::QueueCommand(const PhysicsCommand& command) {
+	std::lock_guard<std::mutex> lock(commandMutex);
+	commands.push_back(command);
+}
+
+/*
+The queue is swapped out rather than worked through in place, so other
+threads can keep queueing commands while these are being carried out.
+*/
+void PhysicsThread::RunCommands() {
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
+		std::swap(commands, runningCommands);
+	}
+	for (const PhysicsCommand& c : runningCommands) {
+		PhysicsObject* phys = c.object->GetPhysicsObject();
+		switch (c.type) {
+			case PhysicsCommand::Type::AddForce:			if (phys) { phys->AddForce(c.value); }							break;
+			case PhysicsCommand::Type::AddForceAtPosition:	if (phys) { phys->AddForceAtPosition(c.value, c.position); }	break;
+			case PhysicsCommand::Type::AddTorque:			if (phys) { phys->AddTorque(c.value); }							break;
+			case PhysicsCommand::Type::SetLinearVelocity:	if (phys) { phys->SetLinearVelocity(c.value); }					break;
+			case PhysicsCommand::Type::SetPosition:			c.object->GetTransform().SetPosition(c.value);					break;
+			case PhysicsCommand::Type::AddObject:			world.AddGameObject(c.object);									break;
+			case PhysicsCommand::Type::RemoveObject:		world.RemoveGameObject(c.object, false);						break;
+			case PhysicsCommand::Type::DeleteObject:		world.RemoveGameObject(c.object, true);							break;
+		}
+	}
+	runningCommands.clear();
+}
+
+//Static objects never move, so they're always safe to draw from their own transforms
+void PhysicsThread::TakeSnapshot(std::vector<RenderSnapshot>& snapshot) const {
+	snapshot.clear();
+	for (BodyType type : { BodyType::Kinematic, BodyType::Dynamic }) {
+		GameObjectIterator first;
+		GameObjectIterator last;
+		world.GetObjectIterators(type, first, last);
+		for (auto i = first; i != last; ++i) {
+			if (RenderObject* r = (*i)->GetRenderObject()) {
+				snapshot.push_back({ r, physics.GetRenderMatrix(**i) });
+			}
+		}
+	}
+}
+
+void PhysicsThread::ApplySnapshot(const std::vector<RenderSnapshot>& snapshot) const {
+	for (const RenderSnapshot& s : snapshot) {
+		s.renderObject->SetSnapshotMatrix(s.matrix);
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "Vector.h"
+#include "Matrix.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		class PhysicsSystem;
+		class GameWorld;
+		class GameObject;
+		class RenderObject;
+
+		/*
+		Something the game wants done to the world, saved up until the physics
+		isn't running - so it can be asked for from anywhere, at any time.
+		*/
+		struct PhysicsCommand {
+			enum class Type {
+				AddForce,
+				AddForceAtPosition,
+				AddTorque,
+				SetLinearVelocity,
+				SetPosition,
+				AddObject,
+				RemoveObject,
+				DeleteObject
+			};
+			Type		type;
+			GameObject* object;
+			Vector3		value;
+			Vector3		position;
+		};
+
+		/*
+		Runs a PhysicsSystem's updates on a thread of its own, so that the
+		simulation of one frame can overlap with the rendering of it.
+
+		Each frame, Finish waits for the last update to end, and then the game
+		has the world all to itself until it calls Begin, which hands the next
+		update over to the physics thread and returns straight away. From then
+		on, until the next Finish, the game mustn't touch anything the physics
+		might - it can only queue up commands, which are carried out at the
+		start of the next Begin.
+
+		The renderer can't read the objects' transforms while they're being
+		simulated, so at the end of every update the physics thread copies the
+		matrices of everything that moves into the back half of a double
+		buffer. Finish swaps the halves over, and hands the copies to the
+		RenderObjects, which draw from them until the next Finish.
+		*/
+		class PhysicsThread {
+		public:
+			PhysicsThread(PhysicsSystem& physics, GameWorld& world);
+			~PhysicsThread();
+
+			void Begin(float dt);
+			void Finish();
+
+			bool IsBusy() const {
+				return busy;
+			}
+
+			//Safe to call from any thread, even while an update is running
+			void QueueCommand(const PhysicsCommand& command);
+
+			void AddForce(GameObject* o, const Vector3& force) {
+				QueueCommand({ PhysicsCommand::Type::AddForce, o, force });
+			}
+
+			void AddForceAtPosition(GameObject* o, const Vector3& force, const Vector3& position) {
+				QueueCommand({ PhysicsCommand::Type::AddForceAtPosition, o, force, position });
+			}
+
+			void AddTorque(GameObject* o, const Vector3& torque) {
+				QueueCommand({ PhysicsCommand::Type::AddTorque, o, torque });
+			}
+
+			void SetLinearVelocity(GameObject* o, const Vector3& velocity) {
+				QueueCommand({ PhysicsCommand::Type::SetLinearVelocity, o, velocity });
+			}
+
+			void SetPosition(GameObject* o, const Vector3& position) {
+				QueueCommand({ PhysicsCommand::Type::SetPosition, o, position });
+			}
+
+			void AddObject(GameObject* o) {
+				QueueCommand({ PhysicsCommand::Type::AddObject, o });
+			}
+
+			void RemoveObject(GameObject* o, bool andDelete = false) {
+				QueueCommand({ andDelete ? PhysicsCommand::Type::DeleteObject : PhysicsCommand::Type::RemoveObject, o });
+			}
+
+			//Makes every RenderObject draw from its real transform again
+			void ClearSnapshots();
+
+		protected:
+			struct RenderSnapshot {
+				RenderObject*	renderObject;
+				Matrix4			matrix;
+			};
+
+			void ThreadLoop();
+			void RunCommands();
+			void TakeSnapshot(std::vector<RenderSnapshot>& snapshot) const;
+			void ApplySnapshot(const std::vector<RenderSnapshot>& snapshot) const;
+
+			PhysicsSystem&	physics;
+			GameWorld&		world;
+
+			std::thread				thread;
+			std::mutex				stateMutex;
+			std::condition_variable updateStarted;
+			std::condition_variable updateFinished;
+			float					updateDT;
+			std::atomic<bool>		busy;	//Changed under stateMutex, but IsBusy can read it from anywhere
+			bool					shuttingDown;
+
+			std::mutex					commandMutex;
+			std::vector<PhysicsCommand>	commands;
+			std::vector<PhysicsCommand>	runningCommands;
+
+			std::vector<RenderSnapshot> snapshots[2];
+			int		backSnapshot;	//Written by the physics thread
+			int		snapshotWorldState;
+		};
+	}
+}
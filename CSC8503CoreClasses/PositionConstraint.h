@@ -12,6 +12,14 @@ namespace NCL {
 
 			void UpdateConstraint(float dt) override;
 
+			GameObject* GetObjectA() const override {
+				return objectA;
+			}
+
+			GameObject* GetObjectB() const override {
+				return objectB;
+			}
+
 		protected:
 			GameObject* objectA;
 			GameObject* objectB;
@@ -1,5 +1,6 @@
 #include "RenderObject.h"
 #include "Mesh.h"
+#include "Transform.h"
 
 using namespace NCL::CSC8503;
 using namespace NCL;
@@ -13,8 +14,13 @@ RenderObject::RenderObject(Transform* parentTransform, Mesh* mesh, Texture* tex,
 	this->texture	= tex;
 	this->shader	= shader;
 	this->colour	= Vector4(1.0f, 1.0f, 1.0f, 1.0f);
+	this->hasSnapshot = false;
 }
 
 RenderObject::~RenderObject() {
 
+}
+
+Matrix4 RenderObject::GetModelMatrix() const {
+	return hasSnapshot ? snapshotMatrix : transform->GetMatrix();
 }
\ No newline at end of file
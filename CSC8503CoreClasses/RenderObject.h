@@ -32,6 +32,23 @@ namespace NCL {
 				return transform;
 			}
 
+			/*
+			While physics is running on its own thread, the transform can be
+			changing while we're trying to draw it, so the renderer draws from a
+			copy of its matrix that the PhysicsThread took instead.
+			*/
+			void SetSnapshotMatrix(const Matrix4& m) {
+				snapshotMatrix	= m;
+				hasSnapshot		= true;
+			}
+
+			void ClearSnapshot() {
+				hasSnapshot = false;
+			}
+
+			//What the renderer should draw the object with
+			Matrix4 GetModelMatrix() const;
+
 			Shader*		GetShader() const {
 				return shader;
 			}
@@ -50,6 +67,8 @@ namespace NCL {
 			Shader*		shader;
 			Transform*	transform;
 			Vector4		colour;
+			Matrix4		snapshotMatrix;
+			bool		hasSnapshot;
 		};
 	}
 }
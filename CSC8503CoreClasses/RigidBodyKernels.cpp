@@ -0,0 +1,231 @@
+#include "RigidBodyKernels.h"
+#include "SIMDLanes.h"
+#include <cmath>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace NCL;
+using namespace CSC8503;
+
+/*
+Builds the world space inverse inertia tensor, R * I * transpose(R), from
+each body's orientation and local inverse inertia. As I is diagonal, each
+element of the result is just a sum of three products.
+*/
+template<class L>
+static size_t UpdateInertiaTensorLanes(const RigidBodyArrays& b, size_t first, size_t last) {
+	typedef typename L::V V;
+	const V one = L::Set(1.0f);
+	const V two = L::Set(2.0f);
+
+	size_t i = first;
+	for (; i + L::Width <= last; i += L::Width) {
+		V qx = L::Load(b.orientation[0] + i);
+		V qy = L::Load(b.orientation[1] + i);
+		V qz = L::Load(b.orientation[2] + i);
+		V qw = L::Load(b.orientation[3] + i);
+		V ix = L::Load(b.inverseInertia[0] + i);
+		V iy = L::Load(b.inverseInertia[1] + i);
+		V iz = L::Load(b.inverseInertia[2] + i);
+
+		V xx = L::Mul(qx, qx);
+		V yy = L::Mul(qy, qy);
+		V zz = L::Mul(qz, qz);
+		V xy = L::Mul(qx, qy);
+		V xz = L::Mul(qx, qz);
+		V yz = L::Mul(qy, qz);
+		V xw = L::Mul(qx, qw);
+		V yw = L::Mul(qy, qw);
+		V zw = L::Mul(qz, qw);
+
+		//Rotation matrix, row by row
+		V r00 = L::Sub(L::Sub(one, L::Mul(two, yy)), L::Mul(two, zz));
+		V r01 = L::Sub(L::Mul(two, xy), L::Mul(two, zw));
+		V r02 = L::Add(L::Mul(two, xz), L::Mul(two, yw));
+		V r10 = L::Add(L::Mul(two, xy), L::Mul(two, zw));
+		V r11 = L::Sub(L::Sub(one, L::Mul(two, xx)), L::Mul(two, zz));
+		V r12 = L::Sub(L::Mul(two, yz), L::Mul(two, xw));
+		V r20 = L::Sub(L::Mul(two, xz), L::Mul(two, yw));
+		V r21 = L::Add(L::Mul(two, yz), L::Mul(two, xw));
+		V r22 = L::Sub(L::Sub(one, L::Mul(two, xx)), L::Mul(two, yy));
+
+		auto Element = [&](V a0, V b0, V a1, V b1, V a2, V b2) {
+			return L::Add(L::Add(L::Mul(L::Mul(a0, b0), ix), L::Mul(L::Mul(a1, b1), iy)), L::Mul(L::Mul(a2, b2), iz));
+		};
+		L::Store(b.inverseInertiaTensor[0] + i, Element(r00, r00, r01, r01, r02, r02));
+		L::Store(b.inverseInertiaTensor[1] + i, Element(r10, r10, r11, r11, r12, r12));
+		L::Store(b.inverseInertiaTensor[2] + i, Element(r20, r20, r21, r21, r22, r22));
+		L::Store(b.inverseInertiaTensor[3] + i, Element(r00, r10, r01, r11, r02, r12));
+		L::Store(b.inverseInertiaTensor[4] + i, Element(r00, r20, r01, r21, r02, r22));
+		L::Store(b.inverseInertiaTensor[5] + i, Element(r10, r20, r11, r21, r12, r22));
+	}
+	return i;
+}
+
+template<class L>
+static size_t IntegrateAccelLanes(const RigidBodyArrays& b, size_t first, size_t last, float dt, const float gravity[3], bool applyGravity) {
+	typedef typename L::V V;
+	const V vdt = L::Set(dt);
+
+	size_t i = first;
+	for (; i + L::Width <= last; i += L::Width) {
+		V im = L::Load(b.inverseMass + i);
+		for (int axis = 0; axis < 3; ++axis) {
+			V accel = L::Mul(L::Load(b.force[axis] + i), im);
+			if (applyGravity) {
+				//Gravity doesn't affect static objects
+				accel = L::SelectPositive(im, L::Add(accel, L::Set(gravity[axis])), accel);
+			}
+			V vel = L::Load(b.linearVelocity[axis] + i);
+			L::Store(b.linearVelocity[axis] + i, L::Add(vel, L::Mul(accel, vdt)));
+		}
+
+		V tx = L::Load(b.torque[0] + i);
+		V ty = L::Load(b.torque[1] + i);
+		V tz = L::Load(b.torque[2] + i);
+		V txx = L::Load(b.inverseInertiaTensor[0] + i);
+		V tyy = L::Load(b.inverseInertiaTensor[1] + i);
+		V tzz = L::Load(b.inverseInertiaTensor[2] + i);
+		V txy = L::Load(b.inverseInertiaTensor[3] + i);
+		V txz = L::Load(b.inverseInertiaTensor[4] + i);
+		V tyz = L::Load(b.inverseInertiaTensor[5] + i);
+
+		auto Row = [&](V a, V c, V d) {
+			return L::Mul(L::Add(L::Add(L::Mul(a, tx), L::Mul(c, ty)), L::Mul(d, tz)), vdt);
+		};
+		L::Store(b.angularVelocity[0] + i, L::Add(L::Load(b.angularVelocity[0] + i), Row(txx, txy, txz)));
+		L::Store(b.angularVelocity[1] + i, L::Add(L::Load(b.angularVelocity[1] + i), Row(txy, tyy, tyz)));
+		L::Store(b.angularVelocity[2] + i, L::Add(L::Load(b.angularVelocity[2] + i), Row(txz, tyz, tzz)));
+	}
+	return i;
+}
+
+template<class L>
+static size_t IntegrateVelocityLanes(const RigidBodyArrays& b, size_t first, size_t last, float dt, float linearDamping, float angularDamping) {
+	typedef typename L::V V;
+	const V vdt		= L::Set(dt);
+	const V halfDt	= L::Set(dt * 0.5f);
+	const V linDamp = L::Set(linearDamping);
+	const V angDamp = L::Set(angularDamping);
+	const V one		= L::Set(1.0f);
+
+	size_t i = first;
+	for (; i + L::Width <= last; i += L::Width) {
+		for (int axis = 0; axis < 3; ++axis) {
+			V pos = L::Load(b.position[axis] + i);
+			V vel = L::Load(b.linearVelocity[axis] + i);
+			L::Store(b.position[axis] + i, L::Add(pos, L::Mul(vel, vdt)));
+			L::Store(b.linearVelocity[axis] + i, L::Mul(vel, linDamp));
+		}
+
+		V avx = L::Load(b.angularVelocity[0] + i);
+		V avy = L::Load(b.angularVelocity[1] + i);
+		V avz = L::Load(b.angularVelocity[2] + i);
+		V qx = L::Load(b.orientation[0] + i);
+		V qy = L::Load(b.orientation[1] + i);
+		V qz = L::Load(b.orientation[2] + i);
+		V qw = L::Load(b.orientation[3] + i);
+
+		//q += Quaternion(angVel * dt * 0.5, 0) * q
+		V ax = L::Mul(avx, halfDt);
+		V ay = L::Mul(avy, halfDt);
+		V az = L::Mul(avz, halfDt);
+
+		V x = L::Sub(L::Add(L::Add(qx, L::Mul(ax, qw)), L::Mul(ay, qz)), L::Mul(az, qy));
+		V y = L::Sub(L::Add(L::Add(qy, L::Mul(ay, qw)), L::Mul(az, qx)), L::Mul(ax, qz));
+		V z = L::Sub(L::Add(L::Add(qz, L::Mul(az, qw)), L::Mul(ax, qy)), L::Mul(ay, qx));
+		V w = L::Sub(L::Sub(L::Sub(qw, L::Mul(ax, qx)), L::Mul(ay, qy)), L::Mul(az, qz));
+
+		V magnitude = L::Sqrt(L::Add(L::Add(L::Add(L::Mul(x, x), L::Mul(y, y)), L::Mul(z, z)), L::Mul(w, w)));
+		V t = L::Div(one, magnitude);
+
+		L::Store(b.orientation[0] + i, L::SelectPositive(magnitude, L::Mul(x, t), x));
+		L::Store(b.orientation[1] + i, L::SelectPositive(magnitude, L::Mul(y, t), y));
+		L::Store(b.orientation[2] + i, L::SelectPositive(magnitude, L::Mul(z, t), z));
+		L::Store(b.orientation[3] + i, L::SelectPositive(magnitude, L::Mul(w, t), w));
+
+		L::Store(b.angularVelocity[0] + i, L::Mul(avx, angDamp));
+		L::Store(b.angularVelocity[1] + i, L::Mul(avy, angDamp));
+		L::Store(b.angularVelocity[2] + i, L::Mul(avz, angDamp));
+	}
+	return i;
+}
+
+/*
+The entry points run as many bodies as they can through the wide lanes,
+and then mop up the rest one at a time.
+*/
+template<class L>
+static void UpdateInertiaTensors(const RigidBodyArrays& b, size_t first, size_t last) {
+	size_t done = UpdateInertiaTensorLanes<L>(b, first, last);
+	UpdateInertiaTensorLanes<ScalarLane>(b, done, last);
+}
+
+template<class L>
+static void IntegrateAccel(const RigidBodyArrays& b, float dt, const float gravity[3], bool applyGravity) {
+	size_t done = IntegrateAccelLanes<L>(b, 0, b.count, dt, gravity, applyGravity);
+	IntegrateAccelLanes<ScalarLane>(b, done, b.count, dt, gravity, applyGravity);
+}
+
+template<class L>
+static void IntegrateVelocity(const RigidBodyArrays& b, float dt, float linearDamping, float angularDamping) {
+	size_t done = IntegrateVelocityLanes<L>(b, 0, b.count, dt, linearDamping, angularDamping);
+	IntegrateVelocityLanes<ScalarLane>(b, done, b.count, dt, linearDamping, angularDamping);
+}
+
+template<class L>
+static const RigidBodyKernels kernelsFor = {
+	&UpdateInertiaTensors<L>,
+	&IntegrateAccel<L>,
+	&IntegrateVelocity<L>
+};
+
+static SIMDLevel DetectSIMDLevel() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool hasSSE2	= (info[3] & (1 << 26)) != 0;
+	bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+	bool hasAVX		= (info[2] & (1 << 28)) != 0;
+
+	bool hasAVX2 = false;
+	if (maxLeaf >= 7 && hasAVX && hasOSXSAVE) {
+		//The OS has to be saving the upper halves of the ymm registers too
+		bool osSavesYMM = (_xgetbv(0) & 0x6) == 0x6;
+		__cpuidex(info, 7, 0);
+		hasAVX2 = osSavesYMM && (info[1] & (1 << 5)) != 0;
+	}
+#else
+	bool hasSSE2 = __builtin_cpu_supports("sse2");
+#endif
+#ifdef NCL_AVX2_KERNELS
+#if !defined(_MSC_VER)
+	bool hasAVX2 = __builtin_cpu_supports("avx2");
+#endif
+	if (hasAVX2) {
+		return SIMDLevel::AVX2;
+	}
+#endif
+	return hasSSE2 ? SIMDLevel::SSE : SIMDLevel::Scalar;
+}
+
+SIMDLevel NCL::CSC8503::GetSupportedSIMDLevel() {
+	static SIMDLevel supported = DetectSIMDLevel();
+	return supported;
+}
+
+const RigidBodyKernels& NCL::CSC8503::GetRigidBodyKernels(SIMDLevel level) {
+	level = std::min(level, GetSupportedSIMDLevel());
+	switch (level) {
+#ifdef NCL_AVX2_KERNELS
+		case SIMDLevel::AVX2:	return kernelsFor<AVX2Lane>;
+#endif
+		case SIMDLevel::SSE:	return kernelsFor<SSELane>;
+		default:				return kernelsFor<ScalarLane>;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+
+namespace NCL {
+	namespace CSC8503 {
+		enum class SIMDLevel {
+			Scalar,
+			SSE,	//4 bodies at a time
+			AVX2	//8 bodies at a time
+		};
+
+		/*
+		Raw pointers into the RigidBodyStore's arrays, so that the kernels
+		don't need to know anything about how the store is laid out.
+		*/
+		struct RigidBodyArrays {
+			size_t	count;
+			float*	position[3];
+			float*	orientation[4];
+			float*	linearVelocity[3];
+			float*	angularVelocity[3];
+			float*	force[3];
+			float*	torque[3];
+			float*	inverseInertia[3];
+			float*	inverseInertiaTensor[6];	//xx, yy, zz, xy, xz, yz
+			float*	inverseMass;
+		};
+
+		/*
+		The integration passes, in scalar, SSE and AVX2 flavours. Every
+		version does exactly the same float operations in exactly the same
+		order (no approximate reciprocals, no fused multiply-adds), so they
+		all give bitwise identical results - which one we run only changes
+		how fast we get there, never where the bodies end up.
+		*/
+		struct RigidBodyKernels {
+			void (*updateInertiaTensors)(const RigidBodyArrays& bodies, size_t first, size_t last);
+			void (*integrateAccel)(const RigidBodyArrays& bodies, float dt, const float gravity[3], bool applyGravity);
+			void (*integrateVelocity)(const RigidBodyArrays& bodies, float dt, float linearDamping, float angularDamping);
+		};
+
+		//The widest instruction set both this CPU and this build can use
+		SIMDLevel GetSupportedSIMDLevel();
+
+		//Asking for more than is supported gets the best we can actually do
+		const RigidBodyKernels& GetRigidBodyKernels(SIMDLevel level);
+	}
+}
@@ -0,0 +1,358 @@
+#include "RigidBodyStore.h"
+#include "PhysicsObject.h"
+#include "Transform.h"
+
+using namespace NCL;
+using namespace CSC8503;
+
+RigidBodyStore::RigidBodyStore() {
+	freeHandle = NullHandle;
+	awakeCount = 0;
+	jobs = nullptr;
+	SetSIMDLevel(GetSupportedSIMDLevel());
+}
+
+RigidBodyStore::~RigidBodyStore() {
+	DetachAll();
+}
+
+int RigidBodyStore::Add(PhysicsObject* owner, Transform* transform) {
+	int handle;
+	if (freeHandle != NullHandle) {
+		handle		= freeHandle;
+		freeHandle	= handleToIndex[handle];
+	}
+	else {
+		handle = (int)handleToIndex.size();
+		handleToIndex.push_back(0);
+	}
+	handleToIndex[handle] = (int)owners.size();
+	indexToHandle.push_back(handle);
+
+	owners.push_back(owner);
+	transforms.push_back(transform);
+
+	Vector3		pos = transform->GetPosition();
+	Quaternion	rot = transform->GetOrientation();
+	position.c[0].push_back(pos.x);
+	position.c[1].push_back(pos.y);
+	position.c[2].push_back(pos.z);
+	orientation.c[0].push_back(rot.x);
+	orientation.c[1].push_back(rot.y);
+	orientation.c[2].push_back(rot.z);
+	orientation.c[3].push_back(rot.w);
+
+	for (int i = 0; i < 3; ++i) {
+		previousPosition.c[i].push_back(position.c[i].back());
+	}
+	for (int i = 0; i < 4; ++i) {
+		previousOrientation.c[i].push_back(orientation.c[i].back());
+	}
+
+	linearVelocity.PushBack();
+	angularVelocity.PushBack();
+	force.PushBack();
+	torque.PushBack();
+	inverseInertia.PushBack();
+	inverseInertiaTensor.PushBack();
+	inverseMass.push_back(0.0f);
+	sleepTime.push_back(0.0f);
+
+	//New bodies start off awake, so move it up to join the others
+	SwapBodies(awakeCount, owners.size() - 1);
+	awakeCount++;
+
+	return handle;
+}
+
+void RigidBodyStore::Remove(int handle) {
+	SetAwake(handle, false);
+	SwapBodies(handleToIndex[handle], owners.size() - 1);
+
+	position.PopBack();
+	orientation.PopBack();
+	previousPosition.PopBack();
+	previousOrientation.PopBack();
+	linearVelocity.PopBack();
+	angularVelocity.PopBack();
+	force.PopBack();
+	torque.PopBack();
+	inverseInertia.PopBack();
+	inverseInertiaTensor.PopBack();
+	inverseMass.pop_back();
+	sleepTime.pop_back();
+	owners.pop_back();
+	transforms.pop_back();
+	indexToHandle.pop_back();
+
+	handleToIndex[handle]	= freeHandle;
+	freeHandle				= handle;
+}
+
+void RigidBodyStore::SwapBodies(size_t a, size_t b) {
+	if (a == b) {
+		return;
+	}
+	position.Swap(a, b);
+	orientation.Swap(a, b);
+	previousPosition.Swap(a, b);
+	previousOrientation.Swap(a, b);
+	linearVelocity.Swap(a, b);
+	angularVelocity.Swap(a, b);
+	force.Swap(a, b);
+	torque.Swap(a, b);
+	inverseInertia.Swap(a, b);
+	inverseInertiaTensor.Swap(a, b);
+	std::swap(inverseMass[a], inverseMass[b]);
+	std::swap(sleepTime[a], sleepTime[b]);
+	std::swap(owners[a], owners[b]);
+	std::swap(transforms[a], transforms[b]);
+	std::swap(indexToHandle[a], indexToHandle[b]);
+
+	handleToIndex[indexToHandle[a]] = (int)a;
+	handleToIndex[indexToHandle[b]] = (int)b;
+}
+
+/*
+Waking a body swaps it with the first sleeping body, and then moves the
+boundary past it - putting one to sleep does the opposite.
+*/
+void RigidBodyStore::SetAwake(int handle, bool awake) {
+	size_t index = handleToIndex[handle];
+	sleepTime[index] = 0.0f;
+
+	if (awake && index >= awakeCount) {
+		SwapBodies(index, awakeCount);
+		awakeCount++;
+	}
+	else if (!awake && index < awakeCount) {
+		for (int axis = 0; axis < 3; ++axis) {
+			linearVelocity.c[axis][index]	= 0.0f;
+			angularVelocity.c[axis][index]	= 0.0f;
+		}
+		awakeCount--;
+		SwapBodies(index, awakeCount);
+	}
+}
+
+void RigidBodyStore::WakeAll() {
+	std::fill(sleepTime.begin(), sleepTime.end(), 0.0f);
+	awakeCount = owners.size();
+}
+
+void RigidBodyStore::DetachAll() {
+	//Detaching removes the body, so keep taking the last one until there are none left
+	while (!owners.empty()) {
+		owners.back()->DetachFromStore();
+	}
+}
+
+Matrix3 RigidBodyStore::GetInertiaTensor(int handle) const {
+	size_t i = handleToIndex[handle];
+	const FloatStreams<6>& t = inverseInertiaTensor;
+
+	Matrix3 m;
+	m.array[0][0] = t.c[0][i];
+	m.array[1][1] = t.c[1][i];
+	m.array[2][2] = t.c[2][i];
+	m.array[0][1] = m.array[1][0] = t.c[3][i];
+	m.array[0][2] = m.array[2][0] = t.c[4][i];
+	m.array[1][2] = m.array[2][1] = t.c[5][i];
+	return m;
+}
+
+void RigidBodyStore::UpdateInertiaTensor(int handle) {
+	size_t i = handleToIndex[handle];
+	//The orientation may have been changed since we last loaded it
+	Quaternion rot = transforms[i]->GetOrientation();
+	orientation.c[0][i] = rot.x;
+	orientation.c[1][i] = rot.y;
+	orientation.c[2][i] = rot.z;
+	orientation.c[3][i] = rot.w;
+	kernels->updateInertiaTensors(GetArrays(), i, i + 1);
+}
+
+void RigidBodyStore::LoadTransforms() {
+	for (size_t i = 0; i < transforms.size(); ++i) {
+		Vector3		pos = transforms[i]->GetPosition();
+		Quaternion	rot = transforms[i]->GetOrientation();
+
+		//Only the game moves things between updates, so there's nothing to blend from
+		bool moved =
+			pos.x != position.c[0][i] || pos.y != position.c[1][i] || pos.z != position.c[2][i] ||
+			rot.x != orientation.c[0][i] || rot.y != orientation.c[1][i] ||
+			rot.z != orientation.c[2][i] || rot.w != orientation.c[3][i];
+
+		position.c[0][i]	= pos.x;
+		position.c[1][i]	= pos.y;
+		position.c[2][i]	= pos.z;
+		orientation.c[0][i] = rot.x;
+		orientation.c[1][i] = rot.y;
+		orientation.c[2][i] = rot.z;
+		orientation.c[3][i] = rot.w;
+
+		if (moved) {
+			for (int axis = 0; axis < 3; ++axis) {
+				previousPosition.c[axis][i] = position.c[axis][i];
+			}
+			for (int axis = 0; axis < 4; ++axis) {
+				previousOrientation.c[axis][i] = orientation.c[axis][i];
+			}
+		}
+	}
+}
+
+/*
+Sleeping bodies are copied too - one that fell asleep at the end of the last
+step would otherwise be left half way between its last two states forever.
+*/
+void RigidBodyStore::SavePreviousState() {
+	for (int axis = 0; axis < 3; ++axis) {
+		previousPosition.c[axis] = position.c[axis];
+	}
+	for (int axis = 0; axis < 4; ++axis) {
+		previousOrientation.c[axis] = orientation.c[axis];
+	}
+}
+
+void RigidBodyStore::GetInterpolatedState(int handle, float alpha, Vector3& pos, Quaternion& rot) const {
+	size_t i = handleToIndex[handle];
+
+	Vector3 from	= Vector3(previousPosition.c[0][i], previousPosition.c[1][i], previousPosition.c[2][i]);
+	Vector3 to		= Vector3(position.c[0][i], position.c[1][i], position.c[2][i]);
+	pos = from + (to - from) * alpha;
+
+	Quaternion fromRot	= Quaternion(previousOrientation.c[0][i], previousOrientation.c[1][i], previousOrientation.c[2][i], previousOrientation.c[3][i]);
+	Quaternion toRot	= Quaternion(orientation.c[0][i], orientation.c[1][i], orientation.c[2][i], orientation.c[3][i]);
+
+	float dot = Quaternion::Dot(fromRot, toRot);
+	if (dot < 0.0f) { //Go the short way round
+		toRot	= -toRot;
+		dot		= -dot;
+	}
+	//Slerp divides by the sine of the angle between them, which falls apart for tiny rotations
+	if (dot > 0.9995f) {
+		rot = Quaternion::Lerp(fromRot, toRot, alpha);
+		rot.Normalise();
+	}
+	else {
+		rot = Quaternion::Slerp(fromRot, toRot, alpha);
+	}
+}
+
+//Sleeping bodies haven't moved, so only the awake ones need writing out
+void RigidBodyStore::StoreTransforms() {
+	for (size_t i = 0; i < awakeCount; ++i) {
+		transforms[i]->SetPositionAndOrientation(
+			Vector3(position.c[0][i], position.c[1][i], position.c[2][i]),
+			Quaternion(orientation.c[0][i], orientation.c[1][i], orientation.c[2][i], orientation.c[3][i])
+		);
+	}
+}
+
+void RigidBodyStore::ClearForces() {
+	for (int axis = 0; axis < 3; ++axis) {
+		std::fill(force.c[axis].begin(), force.c[axis].end(), 0.0f);
+		std::fill(torque.c[axis].begin(), torque.c[axis].end(), 0.0f);
+	}
+}
+
+RigidBodyArrays RigidBodyStore::GetArrays() {
+	RigidBodyArrays a;
+	a.count = awakeCount;
+	for (int i = 0; i < 3; ++i) {
+		a.position[i]			= position.c[i].data();
+		a.linearVelocity[i]		= linearVelocity.c[i].data();
+		a.angularVelocity[i]	= angularVelocity.c[i].data();
+		a.force[i]				= force.c[i].data();
+		a.torque[i]				= torque.c[i].data();
+		a.inverseInertia[i]		= inverseInertia.c[i].data();
+	}
+	for (int i = 0; i < 4; ++i) {
+		a.orientation[i] = orientation.c[i].data();
+	}
+	for (int i = 0; i < 6; ++i) {
+		a.inverseInertiaTensor[i] = inverseInertiaTensor.c[i].data();
+	}
+	a.inverseMass = inverseMass.data();
+	return a;
+}
+
+void RigidBodyStore::SetSIMDLevel(SIMDLevel level) {
+	simdLevel	= std::min(level, GetSupportedSIMDLevel());
+	kernels		= &GetRigidBodyKernels(simdLevel);
+}
+
+/*
+Every body is integrated on its own, so a slice of the arrays is just the
+same pointers moved along - and as the kernels give the same results
+whichever lanes a body ends up in, how the bodies are sliced up can't
+change where they end up.
+*/
+void RigidBodyStore::RunSliced(const std::function<void(const RigidBodyArrays&)>& func) {
+	const size_t sliceSize = 1024;
+
+	RigidBodyArrays arrays = GetArrays();
+	if (!jobs) {
+		func(arrays);
+		return;
+	}
+	jobs->ParallelFor(arrays.count, sliceSize,
+		[&](size_t start, size_t end, unsigned int slot) {
+			RigidBodyArrays slice = arrays;
+			slice.count = end - start;
+			for (int i = 0; i < 3; ++i) {
+				slice.position[i]			+= start;
+				slice.linearVelocity[i]		+= start;
+				slice.angularVelocity[i]	+= start;
+				slice.force[i]				+= start;
+				slice.torque[i]				+= start;
+				slice.inverseInertia[i]		+= start;
+			}
+			for (int i = 0; i < 4; ++i) {
+				slice.orientation[i] += start;
+			}
+			for (int i = 0; i < 6; ++i) {
+				slice.inverseInertiaTensor[i] += start;
+			}
+			slice.inverseMass += start;
+			func(slice);
+		}
+	);
+}
+
+void RigidBodyStore::IntegrateAccel(float dt, const Vector3& gravity, bool applyGravity) {
+	float g[3] = { gravity.x, gravity.y, gravity.z };
+
+	RunSliced([&](const RigidBodyArrays& arrays) {
+		kernels->updateInertiaTensors(arrays, 0, arrays.count);
+		kernels->integrateAccel(arrays, dt, g, applyGravity);
+	});
+}
+
+void RigidBodyStore::IntegrateVelocity(float dt, float linearDamping, float angularDamping) {
+	RunSliced([&](const RigidBodyArrays& arrays) {
+		kernels->integrateVelocity(arrays, dt, linearDamping, angularDamping);
+	});
+}
+
+/*
+Bodies build up sleep time while they're moving slower than the thresholds,
+and lose it all as soon as they speed up again.
+*/
+void RigidBodyStore::UpdateSleepTimes(float dt, float linearThreshold, float angularThreshold) {
+	float linearSq	= linearThreshold * linearThreshold;
+	float angularSq = angularThreshold * angularThreshold;
+
+	for (size_t i = 0; i < awakeCount; ++i) {
+		float lx = linearVelocity.c[0][i];
+		float ly = linearVelocity.c[1][i];
+		float lz = linearVelocity.c[2][i];
+		float ax = angularVelocity.c[0][i];
+		float ay = angularVelocity.c[1][i];
+		float az = angularVelocity.c[2][i];
+
+		bool slow = (lx * lx + ly * ly + lz * lz) < linearSq && (ax * ax + ay * ay + az * az) < angularSq;
+		sleepTime[i] = slow ? sleepTime[i] + dt : 0.0f;
+	}
+}
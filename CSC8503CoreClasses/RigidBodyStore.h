@@ -0,0 +1,212 @@
+#pragma once
+#include "Vector.h"
+#include "Matrix.h"
+#include "Quaternion.h"
+#include "RigidBodyKernels.h"
+#include "JobSystem.h"
+#include <vector>
+#include <functional>
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		class PhysicsObject;
+		class Transform;
+
+		/*
+		A set of equally sized float arrays, one per component, so that a loop
+		over one component of every body walks straight through memory.
+		*/
+		template<int N>
+		struct FloatStreams {
+			std::vector<float> c[N];
+
+			void PushBack(float value = 0.0f) {
+				for (int i = 0; i < N; ++i) {
+					c[i].push_back(value);
+				}
+			}
+
+			void PopBack() {
+				for (int i = 0; i < N; ++i) {
+					c[i].pop_back();
+				}
+			}
+
+			void Swap(size_t a, size_t b) {
+				for (int i = 0; i < N; ++i) {
+					std::swap(c[i][a], c[i][b]);
+				}
+			}
+
+			void Clear() {
+				for (int i = 0; i < N; ++i) {
+					c[i].clear();
+				}
+			}
+		};
+
+		/*
+		Structure-of-arrays storage for the state of every rigid body the
+		PhysicsSystem is simulating. Each quantity lives in its own contiguous
+		array, so the integrators are simple loops over plain floats.
+
+		Bodies are kept packed at the front of the arrays, with all of the
+		awake bodies before all of the sleeping ones, so the integrators only
+		ever have to loop over the first GetAwakeCount() bodies. Removing a
+		body, or waking one up or putting it to sleep, swaps bodies around to
+		keep things that way - so PhysicsObjects keep a handle rather than an
+		index, which stays valid however the bodies are shuffled around.
+
+		Positions and orientations are copies of the Transform values, loaded
+		once per physics update and written back out whenever the integrator
+		has moved things.
+
+		The integration itself is done by SIMD kernels, picked to suit the
+		CPU we're running on (see RigidBodyKernels.h).
+		*/
+		class RigidBodyStore {
+		public:
+			static const int NullHandle = -1;
+
+			RigidBodyStore();
+			~RigidBodyStore();
+
+			int		Add(PhysicsObject* owner, Transform* transform);
+			void	Remove(int handle);
+
+			//Hands every body back to its PhysicsObject
+			void	DetachAll();
+
+			size_t Size() const {
+				return owners.size();
+			}
+
+			size_t GetAwakeCount() const {
+				return awakeCount;
+			}
+
+			PhysicsObject* GetOwner(size_t index) const {
+				return owners[index];
+			}
+
+			int GetHandle(size_t index) const {
+				return indexToHandle[index];
+			}
+
+			//One more than the largest handle given out so far
+			size_t GetHandleLimit() const {
+				return handleToIndex.size();
+			}
+
+			bool IsAwake(int handle) const {
+				return (size_t)handleToIndex[handle] < awakeCount;
+			}
+
+			//Sleeping bodies have their velocities zeroed
+			void SetAwake(int handle, bool awake);
+			void WakeAll();
+
+			//How long a body has been moving slowly enough to be allowed to sleep
+			float GetSleepTime(int handle) const {
+				return sleepTime[handleToIndex[handle]];
+			}
+
+			Vector3 GetPosition(int handle) const		{ return Get(position, handle); }
+			Vector3 GetLinearVelocity(int handle) const	{ return Get(linearVelocity, handle); }
+			Vector3 GetAngularVelocity(int handle) const	{ return Get(angularVelocity, handle); }
+			Vector3 GetForce(int handle) const			{ return Get(force, handle); }
+			Vector3 GetTorque(int handle) const			{ return Get(torque, handle); }
+			Vector3 GetInverseInertia(int handle) const	{ return Get(inverseInertia, handle); }
+
+			void SetPosition(int handle, const Vector3& v)			{ Set(position, handle, v); }
+			void SetLinearVelocity(int handle, const Vector3& v)	{ Set(linearVelocity, handle, v); }
+			void SetAngularVelocity(int handle, const Vector3& v)	{ Set(angularVelocity, handle, v); }
+			void SetForce(int handle, const Vector3& v)				{ Set(force, handle, v); }
+			void SetTorque(int handle, const Vector3& v)			{ Set(torque, handle, v); }
+			void SetInverseInertia(int handle, const Vector3& v)	{ Set(inverseInertia, handle, v); }
+
+			float GetInverseMass(int handle) const {
+				return inverseMass[handleToIndex[handle]];
+			}
+
+			void SetInverseMass(int handle, float invMass) {
+				inverseMass[handleToIndex[handle]] = invMass;
+			}
+
+			Matrix3 GetInertiaTensor(int handle) const;
+			void	UpdateInertiaTensor(int handle);
+
+			void LoadTransforms();
+			void StoreTransforms();
+			void ClearForces();
+
+			/*
+			Each body also remembers where it was at the start of the latest
+			physics step, so that it can be drawn part of the way between its
+			last two steps. Anything the game moves itself is snapped, so that
+			it doesn't look like it slid all the way over to where it was put.
+			*/
+			void SavePreviousState();
+			void GetInterpolatedState(int handle, float alpha, Vector3& pos, Quaternion& rot) const;
+
+			void IntegrateAccel(float dt, const Vector3& gravity, bool applyGravity);
+			void IntegrateVelocity(float dt, float linearDamping, float angularDamping);
+			void UpdateSleepTimes(float dt, float linearThreshold, float angularThreshold);
+
+			//Large stores are integrated in slices, one job each - or all at once, without a JobSystem
+			void SetJobSystem(JobSystem* j) {
+				jobs = j;
+			}
+
+			//Defaults to the widest the CPU supports
+			void SetSIMDLevel(SIMDLevel level);
+
+			SIMDLevel GetSIMDLevel() const {
+				return simdLevel;
+			}
+
+		protected:
+			RigidBodyArrays GetArrays();
+			void RunSliced(const std::function<void(const RigidBodyArrays&)>& func);
+			void SwapBodies(size_t a, size_t b);
+
+			Vector3 Get(const FloatStreams<3>& s, int handle) const {
+				size_t i = handleToIndex[handle];
+				return Vector3(s.c[0][i], s.c[1][i], s.c[2][i]);
+			}
+
+			void Set(FloatStreams<3>& s, int handle, const Vector3& v) {
+				size_t i = handleToIndex[handle];
+				s.c[0][i] = v.x;
+				s.c[1][i] = v.y;
+				s.c[2][i] = v.z;
+			}
+
+			FloatStreams<3>	position;
+			FloatStreams<4>	orientation;
+			FloatStreams<3>	previousPosition;
+			FloatStreams<4>	previousOrientation;
+			FloatStreams<3>	linearVelocity;
+			FloatStreams<3>	angularVelocity;
+			FloatStreams<3>	force;
+			FloatStreams<3>	torque;
+			FloatStreams<3>	inverseInertia;			//Local space, along the body's axes
+			FloatStreams<6>	inverseInertiaTensor;	//World space - symmetric, so xx, yy, zz, xy, xz, yz
+			std::vector<float>	inverseMass;
+			std::vector<float>	sleepTime;
+			size_t				awakeCount;
+
+			std::vector<PhysicsObject*>	owners;
+			std::vector<Transform*>		transforms;
+
+			std::vector<int>	handleToIndex;	//Free handles link to the next free handle instead
+			std::vector<int>	indexToHandle;
+			int					freeHandle;
+
+			SIMDLevel				simdLevel;
+			const RigidBodyKernels*	kernels;
+			JobSystem*				jobs;
+		};
+	}
+}
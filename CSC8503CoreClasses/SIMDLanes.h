@@ -0,0 +1,81 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+//MSVC lets us use AVX2 intrinsics whatever the build flags, and picks the
+//AVX2 kernels at runtime. GCC and Clang only get them when the whole build
+//targets AVX2 (-mavx2), so there it's a compile time choice
+#if defined(_MSC_VER) || defined(__AVX2__)
+#define NCL_AVX2_KERNELS
+#endif
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		Each kernel is written once, against one of these 'lane' types, and then
+		instantiated for each instruction set. The scalar lane is also used to
+		finish off whatever is left over at the end of a SIMD loop.
+		*/
+		struct ScalarLane {
+			typedef float V;
+			static const size_t Width = 1;
+
+			static V Load(const float* p)		{ return *p; }
+			static void Store(float* p, V v)	{ *p = v; }
+			static V Set(float f)				{ return f; }
+			static V Add(V a, V b)				{ return a + b; }
+			static V Sub(V a, V b)				{ return a - b; }
+			static V Mul(V a, V b)				{ return a * b; }
+			static V Div(V a, V b)				{ return a / b; }
+			static V Sqrt(V a)					{ return std::sqrt(a); }
+			static V Min(V a, V b)				{ return (a < b) ? a : b; }
+			static V Max(V a, V b)				{ return (a > b) ? a : b; }
+			//Picks b where a > 0, otherwise keeps c
+			static V SelectPositive(V a, V b, V c) { return (a > 0.0f) ? b : c; }
+		};
+
+		struct SSELane {
+			typedef __m128 V;
+			static const size_t Width = 4;
+
+			static V Load(const float* p)		{ return _mm_loadu_ps(p); }
+			static void Store(float* p, V v)	{ _mm_storeu_ps(p, v); }
+			static V Set(float f)				{ return _mm_set1_ps(f); }
+			static V Add(V a, V b)				{ return _mm_add_ps(a, b); }
+			static V Sub(V a, V b)				{ return _mm_sub_ps(a, b); }
+			static V Mul(V a, V b)				{ return _mm_mul_ps(a, b); }
+			static V Div(V a, V b)				{ return _mm_div_ps(a, b); }
+			static V Sqrt(V a)					{ return _mm_sqrt_ps(a); }
+			static V Min(V a, V b)				{ return _mm_min_ps(a, b); }
+			static V Max(V a, V b)				{ return _mm_max_ps(a, b); }
+			static V SelectPositive(V a, V b, V c) {
+				V mask = _mm_cmpgt_ps(a, _mm_setzero_ps());
+				return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, c));
+			}
+		};
+
+		#ifdef NCL_AVX2_KERNELS
+		struct AVX2Lane {
+			typedef __m256 V;
+			static const size_t Width = 8;
+
+			static V Load(const float* p)		{ return _mm256_loadu_ps(p); }
+			static void Store(float* p, V v)	{ _mm256_storeu_ps(p, v); }
+			static V Set(float f)				{ return _mm256_set1_ps(f); }
+			static V Add(V a, V b)				{ return _mm256_add_ps(a, b); }
+			static V Sub(V a, V b)				{ return _mm256_sub_ps(a, b); }
+			static V Mul(V a, V b)				{ return _mm256_mul_ps(a, b); }
+			static V Div(V a, V b)				{ return _mm256_div_ps(a, b); }
+			static V Sqrt(V a)					{ return _mm256_sqrt_ps(a); }
+			static V Min(V a, V b)				{ return _mm256_min_ps(a, b); }
+			static V Max(V a, V b)				{ return _mm256_max_ps(a, b); }
+			static V SelectPositive(V a, V b, V c) {
+				V mask = _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ);
+				return _mm256_blendv_ps(c, b, mask);
+			}
+		};
+		#endif
+	}
+}
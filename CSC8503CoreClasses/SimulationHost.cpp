@@ -0,0 +1,80 @@
+#include "SimulationHost.h"
+#include "GameTimer.h"
+
+#include <algorithm>
+
+using namespace NCL;
+using namespace CSC8503;
+
+const float tickTimeSmoothing = 0.1f;
+
+SimulationHost::SimulationHost(JobSystem& j) : jobs(j) {
+	worldCount		= 0;
+	lastUpdateTime	= 0.0f;
+}
+
+SimulationHost::~SimulationHost() {
+}
+
+int SimulationHost::AddWorld(const TickFunc& tick) {
+	auto freeSlot = std::find(worlds.begin(), worlds.end(), nullptr);
+	if (freeSlot == worlds.end()) {
+		freeSlot = worlds.insert(worlds.end(), nullptr);
+	}
+	*freeSlot = std::make_unique<HostedWorld>(tick, jobs);
+	worldCount++;
+	return (int)(freeSlot - worlds.begin());
+}
+
+void SimulationHost::RemoveWorld(int id) {
+	worlds[id].reset();
+	worldCount--;
+}
+
+void SimulationHost::Update(float dt) {
+	GameTimer t;
+
+	//Worlds can take very different amounts of time, so hand them out one at a time
+	jobs.ParallelFor(worlds.size(), 1,
+		[&](size_t start, size_t end, unsigned int threadIndex) {
+			for (size_t i = start; i < end; ++i) {
+				if (worlds[i]) {
+					worlds[i]->Tick(dt);
+				}
+			}
+		}
+	);
+	t.Tick();
+	lastUpdateTime = t.GetTimeDeltaSeconds();
+}
+
+SimulationHost::HostedWorld::HostedWorld(const TickFunc& t, JobSystem& jobs) : physics(world, jobs), tick(t) {
+	stats = {};
+}
+
+SimulationHost::HostedWorld::~HostedWorld() {
+	physics.Clear();
+	world.ClearAndErase();
+}
+
+//The same order TutorialGame updates things in, without the rendering
+void SimulationHost::HostedWorld::Tick(float dt) {
+	GameTimer t;
+
+	if (tick) {
+		tick(world, physics, dt);
+	}
+	world.UpdateWorld(dt);
+	physics.Update(dt);
+	physics.DispatchCollisionEvents();
+
+	t.Tick();
+	float tickTime = t.GetTimeDeltaSeconds();
+
+	stats.averageTickTime	= (stats.tickCount > 0) ? stats.averageTickTime + (tickTime - stats.averageTickTime) * tickTimeSmoothing : tickTime;
+	stats.lastTickTime		= tickTime;
+	stats.maxTickTime		= std::max(stats.maxTickTime, tickTime);
+	stats.stepRate			= physics.GetStepRate();
+	stats.objectCount		= world.GetObjectCount();
+	stats.tickCount++;
+}
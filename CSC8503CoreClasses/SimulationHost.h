@@ -0,0 +1,86 @@
+#pragma once
+#include "GameWorld.h"
+#include "PhysicsSystem.h"
+#include "JobSystem.h"
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace NCL {
+	namespace CSC8503 {
+		//How one of a SimulationHost's worlds has been getting on
+		struct WorldTickStats {
+			uint64_t	tickCount;
+			float		lastTickTime;		//Seconds, for the whole tick - game logic and physics
+			float		averageTickTime;	//Smoothed over the last few ticks
+			float		maxTickTime;
+			int			stepRate;			//The PhysicsSystem's current steps per second
+			size_t		objectCount;
+		};
+
+		/*
+		Runs lots of completely separate worlds - one per match on a
+		dedicated server, say - without any window, keyboard or renderer.
+		Each world gets its own GameWorld and PhysicsSystem, and every Update
+		ticks them all, each world as a job of its own.
+
+		The worlds' PhysicsSystems share the same JobSystem, so a busy world
+		can have its physics picked up by threads that have already finished
+		ticking quieter ones. Nothing may touch a world from outside while
+		Update is running.
+
+		Worlds are referred to by an ID, which stays the same until the world
+		is removed - after which it might be given to a new world.
+		*/
+		class SimulationHost {
+		public:
+			//Game logic for a world, run at the start of each of its ticks
+			typedef std::function<void(GameWorld&, PhysicsSystem&, float)> TickFunc;
+
+			SimulationHost(JobSystem& jobs = JobSystem::GetShared());
+			~SimulationHost();
+
+			int		AddWorld(const TickFunc& tick = nullptr);
+			//Deletes everything that was in the world, too
+			void	RemoveWorld(int id);
+
+			//Ticks every world by dt, and returns once they've all finished
+			void Update(float dt);
+
+			GameWorld&		GetWorld(int id)	{ return worlds[id]->world; }
+			PhysicsSystem&	GetPhysics(int id)	{ return worlds[id]->physics; }
+
+			const WorldTickStats& GetStats(int id) const {
+				return worlds[id]->stats;
+			}
+
+			size_t GetWorldCount() const {
+				return worldCount;
+			}
+
+			//How long the last Update took, from start to finish
+			float GetLastUpdateTime() const {
+				return lastUpdateTime;
+			}
+
+		protected:
+			struct HostedWorld {
+				HostedWorld(const TickFunc& t, JobSystem& jobs);
+				~HostedWorld();
+
+				void Tick(float dt);
+
+				GameWorld		world;
+				PhysicsSystem	physics;	//Must come after the world it simulates
+				TickFunc		tick;
+				WorldTickStats	stats;
+			};
+
+			std::vector<std::unique_ptr<HostedWorld>>	worlds;	//Removed worlds leave an empty slot
+			size_t										worldCount;
+			JobSystem&									jobs;
+			float										lastUpdateTime;
+		};
+	}
+}
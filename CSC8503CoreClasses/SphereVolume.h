@@ -2,7 +2,7 @@
 #include "CollisionVolume.h"
 
 namespace NCL {
-	class SphereVolume : CollisionVolume
+	class SphereVolume : public CollisionVolume
 	{
 	public:
 		SphereVolume(float sphereRadius = 1.0f) {
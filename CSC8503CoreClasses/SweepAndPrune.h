@@ -0,0 +1,195 @@
+#pragma once
+#include "Vector.h"
+#include <vector>
+#include <algorithm>
+
+namespace NCL {
+	using namespace NCL::Maths;
+	namespace CSC8503 {
+		struct SAPEndpoint {
+			float	value;
+			int		proxy;
+			bool	isMin;
+
+			bool operator < (const SAPEndpoint& other) const {
+				if (value != other.value) {
+					return value < other.value;
+				}
+				//Touching boxes don't count as overlapping, so close a box before opening the next
+				return !isMin && other.isMin;
+			}
+		};
+
+		template<class T>
+		struct SAPProxy {
+			T		object;
+			Vector3 boxMin;
+			Vector3 boxMax;
+			int		activeIndex;
+			bool	inUse;
+		};
+
+		/*
+		Sort and sweep broadphase. We keep two arrays of box endpoints (one for
+		the x axis, one for the z axis) sorted across frames. As objects don't
+		tend to move very far in a single step, the arrays are almost sorted
+		already, so an insertion sort gets them back in order in close to linear
+		time.
+
+		Pairs are found by sweeping along whichever of the two axes the objects
+		are spread out over the most, keeping a list of the boxes we're currently
+		'inside'. As most of our levels are laid out flat on the xz plane, the y
+		axis is never worth sorting.
+		*/
+		template<class T>
+		class SweepAndPrune {
+		public:
+			static const int NullProxy = -1;
+
+			SweepAndPrune() {
+				Clear();
+			}
+			~SweepAndPrune() {
+			}
+
+			void Clear() {
+				proxies.clear();
+				endpoints[0].clear();
+				endpoints[1].clear();
+				active.clear();
+				freeList	= NullProxy;
+				fullSort	= false;
+			}
+
+			int Insert(T object, const Vector3& pos, const Vector3& halfSize) {
+				int proxy;
+				if (freeList != NullProxy) {
+					proxy		= freeList;
+					freeList	= proxies[proxy].activeIndex;
+				}
+				else {
+					proxy = (int)proxies.size();
+					proxies.emplace_back();
+				}
+				SAPProxy<T>& p = proxies[proxy];
+				p.object		= object;
+				p.boxMin		= pos - halfSize;
+				p.boxMax		= pos + halfSize;
+				p.activeIndex	= NullProxy;
+				p.inUse			= true;
+
+				for (int axis = 0; axis < 2; ++axis) {
+					endpoints[axis].push_back({ 0.0f, proxy, true });
+					endpoints[axis].push_back({ 0.0f, proxy, false });
+				}
+				//New endpoints are just tacked onto the end, which would be the
+				//worst case for an insertion sort, so do a full sort instead
+				fullSort = true;
+				return proxy;
+			}
+
+			void Remove(int proxy) {
+				for (int axis = 0; axis < 2; ++axis) {
+					std::vector<SAPEndpoint>& e = endpoints[axis];
+					e.erase(std::remove_if(e.begin(), e.end(), [&](const SAPEndpoint& p) { return p.proxy == proxy; }), e.end());
+				}
+				proxies[proxy].inUse		= false;
+				proxies[proxy].activeIndex	= freeList;	//Doubles as the free list link
+				freeList = proxy;
+			}
+
+			void Update(int proxy, const Vector3& pos, const Vector3& halfSize) {
+				proxies[proxy].boxMin = pos - halfSize;
+				proxies[proxy].boxMax = pos + halfSize;
+			}
+
+			/*
+			Calls func(a, b) once for every pair of overlapping boxes.
+			*/
+			template<typename Func>
+			void FindPairs(Func&& func) {
+				int sweepAxis = SortEndpoints();
+
+				active.clear();
+				for (const SAPEndpoint& e : endpoints[sweepAxis]) {
+					SAPProxy<T>& p = proxies[e.proxy];
+					if (!e.isMin) {
+						//A box with no width on this axis may close before it opens - it
+						//then just stays in the active list, which costs a few extra tests
+						bool isActive = p.activeIndex >= 0 && p.activeIndex < (int)active.size() && active[p.activeIndex] == e.proxy;
+						if (isActive) {
+							int last = active.back();
+							active[p.activeIndex]		= last;
+							proxies[last].activeIndex	= p.activeIndex;
+							active.pop_back();
+						}
+						continue;
+					}
+					for (int other : active) {
+						const SAPProxy<T>& o = proxies[other];
+						if (p.boxMin.x < o.boxMax.x && p.boxMax.x > o.boxMin.x &&
+							p.boxMin.y < o.boxMax.y && p.boxMax.y > o.boxMin.y &&
+							p.boxMin.z < o.boxMax.z && p.boxMax.z > o.boxMin.z) {
+							func(o.object, p.object);
+						}
+					}
+					p.activeIndex = (int)active.size();
+					active.push_back(e.proxy);
+				}
+			}
+
+		protected:
+			/*
+			Refreshes the endpoint values from the proxy boxes, and gets both
+			axes back into order. Returns the axis (0 for x, 1 for z) with the
+			greatest variance in box centres, as that's the one that'll give us
+			the fewest false positives while sweeping.
+			*/
+			int SortEndpoints() {
+				float sum[2]	= { 0.0f, 0.0f };
+				float sumSq[2]	= { 0.0f, 0.0f };
+
+				for (int axis = 0; axis < 2; ++axis) {
+					int component = (axis == 0) ? 0 : 2;
+					for (SAPEndpoint& e : endpoints[axis]) {
+						const SAPProxy<T>& p = proxies[e.proxy];
+						e.value = e.isMin ? p.boxMin[component] : p.boxMax[component];
+						sum[axis]	+= e.value;
+						sumSq[axis] += e.value * e.value;
+					}
+					if (fullSort) {
+						std::sort(endpoints[axis].begin(), endpoints[axis].end());
+					}
+					else {
+						InsertionSort(endpoints[axis]);
+					}
+				}
+				fullSort = false;
+
+				float count = (float)std::max<size_t>(endpoints[0].size(), 1);
+				float varianceX = sumSq[0] - (sum[0] * sum[0]) / count;
+				float varianceZ = sumSq[1] - (sum[1] * sum[1]) / count;
+
+				return (varianceX >= varianceZ) ? 0 : 1;
+			}
+
+			static void InsertionSort(std::vector<SAPEndpoint>& e) {
+				for (size_t i = 1; i < e.size(); ++i) {
+					SAPEndpoint key = e[i];
+					size_t j = i;
+					while (j > 0 && key < e[j - 1]) {
+						e[j] = e[j - 1];
+						--j;
+					}
+					e[j] = key;
+				}
+			}
+
+			std::vector<SAPProxy<T>>	proxies;
+			std::vector<SAPEndpoint>	endpoints[2];
+			std::vector<int>			active;
+			int		freeList;
+			bool	fullSort;
+		};
+	}
+}
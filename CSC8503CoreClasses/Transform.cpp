@@ -1,36 +1,120 @@
 #include "Transform.h"
+#include "TransformKernels.h"
+#include <algorithm>
 
 using namespace NCL::CSC8503;
 
 Transform::Transform()	{
-	scale = Vector3(1, 1, 1);
+	scale		= Vector3(1, 1, 1);
+	matrixDirty = true;
 }
 
 Transform::~Transform()	{
 
 }
 
-void Transform::UpdateMatrix() {
-	matrix =
-		Matrix::Translation(position) *
-		Quaternion::RotationMatrix<Matrix4>(orientation) *
-		Matrix::Scale(scale);
+/*
+A batch of one, pointed straight at our own members - so a matrix built on
+demand comes out exactly the same as one built by UpdateMatrices. The
+bottom row was set when the matrix was constructed, and never changes.
+*/
+void Transform::UpdateMatrix() const {
+	TransformBatchArrays t;
+	t.count				= 1;
+	t.position[0]		= &position.x;
+	t.position[1]		= &position.y;
+	t.position[2]		= &position.z;
+	t.orientation[0]	= &orientation.x;
+	t.orientation[1]	= &orientation.y;
+	t.orientation[2]	= &orientation.z;
+	t.orientation[3]	= &orientation.w;
+	t.scale[0]			= &scale.x;
+	t.scale[1]			= &scale.y;
+	t.scale[2]			= &scale.z;
+	for (int i = 0; i < 9; ++i) {
+		t.basis[i] = &matrix.array[i / 3][i % 3];
+	}
+	GetTransformKernels(SIMDLevel::Scalar).buildMatrices(t, 0, 1);
+
+	matrix.array[3][0]	= position.x;
+	matrix.array[3][1]	= position.y;
+	matrix.array[3][2]	= position.z;
+	matrixDirty			= false;
+}
+
+/*
+The transforms are copied into arrays a chunk at a time, so the kernels can
+work on plain float arrays without us having to allocate any memory.
+*/
+void Transform::UpdateMatrices(Transform* const* transforms, size_t count) {
+	const size_t ChunkSize = 64;
+	float input[10][ChunkSize];
+	float basis[9][ChunkSize];
+
+	TransformBatchArrays t;
+	for (int i = 0; i < 3; ++i) {
+		t.position[i]		= input[i];
+		t.orientation[i]	= input[3 + i];
+		t.scale[i]			= input[7 + i];
+	}
+	t.orientation[3] = input[6];
+	for (int i = 0; i < 9; ++i) {
+		t.basis[i] = basis[i];
+	}
+	const TransformKernels& kernels = GetTransformKernels(GetSupportedSIMDLevel());
+
+	for (size_t first = 0; first < count; first += ChunkSize) {
+		t.count = std::min(ChunkSize, count - first);
+
+		for (size_t i = 0; i < t.count; ++i) {
+			const Transform& from = *transforms[first + i];
+			input[0][i] = from.position.x;
+			input[1][i] = from.position.y;
+			input[2][i] = from.position.z;
+			input[3][i] = from.orientation.x;
+			input[4][i] = from.orientation.y;
+			input[5][i] = from.orientation.z;
+			input[6][i] = from.orientation.w;
+			input[7][i] = from.scale.x;
+			input[8][i] = from.scale.y;
+			input[9][i] = from.scale.z;
+		}
+		kernels.buildMatrices(t, 0, t.count);
+
+		for (size_t i = 0; i < t.count; ++i) {
+			const Transform& to = *transforms[first + i];
+			for (int j = 0; j < 9; ++j) {
+				to.matrix.array[j / 3][j % 3] = basis[j][i];
+			}
+			to.matrix.array[3][0]	= to.position.x;
+			to.matrix.array[3][1]	= to.position.y;
+			to.matrix.array[3][2]	= to.position.z;
+			to.matrixDirty			= false;
+		}
+	}
 }
 
 Transform& Transform::SetPosition(const Vector3& worldPos) {
-	position = worldPos;
-	UpdateMatrix();
+	position	= worldPos;
+	matrixDirty = true;
 	return *this;
 }
 
 Transform& Transform::SetScale(const Vector3& worldScale) {
-	scale = worldScale;
-	UpdateMatrix();
+	scale		= worldScale;
+	matrixDirty = true;
 	return *this;
 }
 
 Transform& Transform::SetOrientation(const Quaternion& worldOrientation) {
 	orientation = worldOrientation;
-	UpdateMatrix();
+	matrixDirty = true;
+	return *this;
+}
+
+Transform& Transform::SetPositionAndOrientation(const Vector3& worldPos, const Quaternion& worldOrientation) {
+	position	= worldPos;
+	orientation = worldOrientation;
+	matrixDirty = true;
 	return *this;
 }
\ No newline at end of file
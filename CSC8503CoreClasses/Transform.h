@@ -15,6 +15,7 @@ namespace NCL {
 			Transform& SetPosition(const Vector3& worldPos);
 			Transform& SetScale(const Vector3& worldScale);
 			Transform& SetOrientation(const Quaternion& newOr);
+			Transform& SetPositionAndOrientation(const Vector3& worldPos, const Quaternion& newOr);
 
 			Vector3 GetPosition() const {
 				return position;
@@ -28,12 +29,33 @@ namespace NCL {
 				return orientation;
 			}
 
+			/*
+			Setting the position, orientation or scale just marks the matrix as
+			out of date, as things like the physics can move an object many
+			times before anyone wants to draw it. GameWorld::UpdateTransforms
+			then rebuilds every out of date matrix in one go before rendering,
+			and anything asking for a matrix before that gets it built there
+			and then - so don't call this while something else is moving the
+			object on another thread.
+			*/
 			Matrix4 GetMatrix() const {
+				if (matrixDirty) {
+					UpdateMatrix();
+				}
 				return matrix;
 			}
-			void UpdateMatrix();
+
+			bool IsMatrixDirty() const {
+				return matrixDirty;
+			}
+
+			void UpdateMatrix() const;
+
+			//Rebuilds the matrices of all of the given transforms with the SIMD kernels
+			static void UpdateMatrices(Transform* const* transforms, size_t count);
 		protected:
-			Matrix4		matrix;
+			mutable Matrix4	matrix;
+			mutable bool	matrixDirty;
 			Quaternion	orientation;
 			Vector3		position;
 
@@ -0,0 +1,70 @@
+#include "TransformKernels.h"
+#include "SIMDLanes.h"
+#include <algorithm>
+
+using namespace NCL;
+using namespace CSC8503;
+
+template<class L>
+static size_t BuildMatricesLanes(const TransformBatchArrays& t, size_t first, size_t last) {
+	typedef typename L::V V;
+	const V one = L::Set(1.0f);
+	const V two = L::Set(2.0f);
+
+	size_t i = first;
+	for (; i + L::Width <= last; i += L::Width) {
+		V qx = L::Load(t.orientation[0] + i);
+		V qy = L::Load(t.orientation[1] + i);
+		V qz = L::Load(t.orientation[2] + i);
+		V qw = L::Load(t.orientation[3] + i);
+		V sx = L::Load(t.scale[0] + i);
+		V sy = L::Load(t.scale[1] + i);
+		V sz = L::Load(t.scale[2] + i);
+
+		V xx = L::Mul(qx, qx);
+		V yy = L::Mul(qy, qy);
+		V zz = L::Mul(qz, qz);
+		V xy = L::Mul(qx, qy);
+		V xz = L::Mul(qx, qz);
+		V yz = L::Mul(qy, qz);
+		V xw = L::Mul(qx, qw);
+		V yw = L::Mul(qy, qw);
+		V zw = L::Mul(qz, qw);
+
+		//Same terms as Quaternion::RotationMatrix, one column at a time
+		L::Store(t.basis[0] + i, L::Mul(L::Sub(L::Sub(one, L::Mul(two, yy)), L::Mul(two, zz)), sx));
+		L::Store(t.basis[1] + i, L::Mul(L::Add(L::Mul(two, xy), L::Mul(two, zw)), sx));
+		L::Store(t.basis[2] + i, L::Mul(L::Sub(L::Mul(two, xz), L::Mul(two, yw)), sx));
+
+		L::Store(t.basis[3] + i, L::Mul(L::Sub(L::Mul(two, xy), L::Mul(two, zw)), sy));
+		L::Store(t.basis[4] + i, L::Mul(L::Sub(L::Sub(one, L::Mul(two, xx)), L::Mul(two, zz)), sy));
+		L::Store(t.basis[5] + i, L::Mul(L::Add(L::Mul(two, yz), L::Mul(two, xw)), sy));
+
+		L::Store(t.basis[6] + i, L::Mul(L::Add(L::Mul(two, xz), L::Mul(two, yw)), sz));
+		L::Store(t.basis[7] + i, L::Mul(L::Sub(L::Mul(two, yz), L::Mul(two, xw)), sz));
+		L::Store(t.basis[8] + i, L::Mul(L::Sub(L::Sub(one, L::Mul(two, xx)), L::Mul(two, yy)), sz));
+	}
+	return i;
+}
+
+template<class L>
+static void BuildMatrices(const TransformBatchArrays& t, size_t first, size_t last) {
+	size_t done = BuildMatricesLanes<L>(t, first, last);
+	BuildMatricesLanes<ScalarLane>(t, done, last);
+}
+
+template<class L>
+static const TransformKernels kernelsFor = {
+	&BuildMatrices<L>
+};
+
+const TransformKernels& NCL::CSC8503::GetTransformKernels(SIMDLevel level) {
+	level = std::min(level, GetSupportedSIMDLevel());
+	switch (level) {
+#ifdef NCL_AVX2_KERNELS
+		case SIMDLevel::AVX2:	return kernelsFor<AVX2Lane>;
+#endif
+		case SIMDLevel::SSE:	return kernelsFor<SSELane>;
+		default:				return kernelsFor<ScalarLane>;
+	}
+}
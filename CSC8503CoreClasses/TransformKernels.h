@@ -0,0 +1,33 @@
+#pragma once
+#include "RigidBodyKernels.h"
+
+namespace NCL {
+	namespace CSC8503 {
+		/*
+		A batch of Transforms to build matrices for, laid out as one array per
+		component like the RigidBodyArrays. The kernels only fill in the
+		upper 3x3 of each matrix - the rotation, with each column multiplied
+		by that axis' scale - as the translation is just the position, and
+		the bottom row never changes.
+		*/
+		struct TransformBatchArrays {
+			size_t			count;
+			const float*	position[3];
+			const float*	orientation[4];
+			const float*	scale[3];
+
+			float*			basis[9];	//Column by column, like Matrix4::array
+		};
+
+		/*
+		Builds the same matrix as Translation * RotationMatrix * Scale, in the
+		same scalar, SSE and AVX2 flavours as the integrators, and with the
+		same float operations whichever flavour runs.
+		*/
+		struct TransformKernels {
+			void (*buildMatrices)(const TransformBatchArrays& transforms, size_t first, size_t last);
+		};
+
+		const TransformKernels& GetTransformKernels(SIMDLevel level);
+	}
+}
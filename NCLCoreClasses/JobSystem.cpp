@@ -0,0 +1,248 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace NCL;
+
+//Which JobSystem (if any) the current thread is a worker for, and which one it is
+static thread_local JobSystem*	currentSystem = nullptr;
+static thread_local size_t		currentWorker = 0;
+
+JobSystem::JobSystem(int workerCount) {
+	pendingJobs		= 0;
+	shuttingDown	= false;
+
+	if (workerCount < 0) {
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? (int)hardwareThreads - 1 : 0;
+	}
+	for (int i = 0; i <= workerCount; ++i) {
+		queues.push_back(std::make_unique<JobQueue>());
+	}
+	for (int i = 0; i < workerCount; ++i) {
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		shuttingDown = true;
+	}
+	jobAvailable.notify_all();
+	for (std::thread& t : workers) {
+		t.join();
+	}
+}
+
+JobSystem& JobSystem::GetShared() {
+	static JobSystem shared;
+	return shared;
+}
+
+void JobSystem::Run(JobFunc func, JobCounter* counter, JobCounter* after) {
+	if (counter) {
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+	}
+	Job job = { std::move(func), counter };
+	if (after) {
+		std::lock_guard<std::mutex> lock(after->waitingMutex);
+		if (after->count.load(std::memory_order_acquire) > 0) {
+			after->waitingJobs.push_back(std::move(job));
+			return;
+		}
+	}
+	Push(std::move(job));
+}
+
+/*
+The last job to finish might still be holding on to the counter's mutex,
+so we have to wait for it to let go, or the counter could be destroyed
+out from under it.
+*/
+void JobSystem::Wait(JobCounter& counter) {
+	while (!counter.IsDone()) {
+		if (!TryRunJob()) {
+			std::this_thread::yield();
+		}
+	}
+	std::lock_guard<std::mutex> lock(counter.waitingMutex);
+}
+
+/*
+Only as many helper jobs as there are workers are queued up, and each
+takes batches until there are none left - so a big range costs a few
+jobs, not one per batch. The helpers might not get started until the
+caller has done all of the batches itself, in which case they have
+nothing to do, and finish straight away.
+*/
+void JobSystem::ParallelFor(size_t count, size_t batchSize, const BatchFunc& func) {
+	if (count == 0) {
+		return;
+	}
+	batchSize = batchSize > 0 ? batchSize : 1;
+	size_t batchCount	= (count + batchSize - 1) / batchSize;
+	size_t helperCount	= std::min(batchCount - 1, workers.size());
+
+	//Not worth waking anyone up for a single batch
+	if (helperCount == 0) {
+		func(0, count, 0);
+		return;
+	}
+	std::atomic<size_t> nextBatch = 0;
+	auto runBatches = [&](unsigned int slot) {
+		while (true) {
+			size_t batch = nextBatch.fetch_add(1, std::memory_order_relaxed);
+			if (batch >= batchCount) {
+				return;
+			}
+			size_t start = batch * batchSize;
+			func(start, std::min(start + batchSize, count), slot);
+		}
+	};
+	JobCounter helpers;
+	for (size_t i = 1; i <= helperCount; ++i) {
+		Run([&runBatches, i] { runBatches((unsigned int)i); }, &helpers);
+	}
+	runBatches(0);
+	Wait(helpers);
+}
+
+void JobSystem::WorkerLoop(unsigned int workerIndex) {
+	currentSystem = this;
+	currentWorker = workerIndex;
+
+	while (true) {
+		if (TryRunJob()) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		jobAvailable.wait(lock, [&] { return shuttingDown || pendingJobs.load() > 0; });
+		if (shuttingDown) {
+			return;
+		}
+	}
+}
+
+//Workers queue jobs up for themselves, and everyone else uses the shared queue
+void JobSystem::Push(Job&& job) {
+	size_t queueIndex = (currentSystem == this) ? currentWorker : queues.size() - 1;
+	{
+		JobQueue& q = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.jobs.push_back(std::move(job));
+	}
+	pendingJobs.fetch_add(1);
+	{
+		//A worker that's just about to go to sleep has to see the new job first
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	jobAvailable.notify_one();
+}
+
+bool JobSystem::TakeJob(Job& job) {
+	if (pendingJobs.load() == 0) {
+		return false;
+	}
+	size_t queueCount	= queues.size();
+	size_t ownQueue		= (currentSystem == this) ? currentWorker : queueCount - 1;
+	{
+		JobQueue& q = *queues[ownQueue];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (!q.jobs.empty()) {
+			job = std::move(q.jobs.back());
+			q.jobs.pop_back();
+			pendingJobs.fetch_sub(1);
+			return true;
+		}
+	}
+	for (size_t i = 1; i < queueCount; ++i) {
+		JobQueue& q = *queues[(ownQueue + i) % queueCount];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (!q.jobs.empty()) {
+			job = std::move(q.jobs.front());
+			q.jobs.pop_front();
+			pendingJobs.fetch_sub(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::TryRunJob() {
+	Job job;
+	if (!TakeJob(job)) {
+		return false;
+	}
+	Execute(job);
+	return true;
+}
+
+/*
+Once a counter is done, anything that was waiting for it can be started -
+the count is changed with the lock held, so that a job being added to the
+waiting list can't miss it.
+*/
+void JobSystem::Execute(Job& job) {
+	job.func();
+	if (!job.counter) {
+		return;
+	}
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> lock(job.counter->waitingMutex);
+		if (job.counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			ready.swap(job.counter->waitingJobs);
+		}
+	}
+	for (Job& r : ready) {
+		Push(std::move(r));
+	}
+}
+
+ScratchAllocator::ScratchAllocator(size_t blockSize) : blockSize(blockSize) {
+	currentBlock	= 0;
+	offset			= 0;
+}
+
+ScratchAllocator::~ScratchAllocator() {
+}
+
+ScratchAllocator& ScratchAllocator::ForThisThread() {
+	static thread_local ScratchAllocator allocator;
+	return allocator;
+}
+
+/*
+If what's asked for doesn't fit in what's left of the current block, we
+move on to the next - and if that one's too small too (or there isn't
+one), it's replaced with one that's big enough. Anything past the current
+block isn't in use, so it's safe to throw away.
+*/
+void* ScratchAllocator::Allocate(size_t bytes, size_t alignment) {
+	while (currentBlock < blocks.size()) {
+		Block&		block	= blocks[currentBlock];
+		uintptr_t	base	= (uintptr_t)block.memory.get();
+		size_t		start	= (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+		if (start + bytes <= block.size) {
+			offset = start + bytes;
+			return block.memory.get() + start;
+		}
+		if (offset == 0) {
+			break; //Even a whole block isn't enough
+		}
+		currentBlock++;
+		offset = 0;
+	}
+	Block block;
+	block.size		= std::max(blockSize, bytes + alignment);
+	block.memory	= std::make_unique<char[]>(block.size);
+	if (currentBlock < blocks.size()) {
+		blocks[currentBlock] = std::move(block);
+	}
+	else {
+		blocks.push_back(std::move(block));
+	}
+	return Allocate(bytes, alignment);
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstddef>
+
+namespace NCL {
+	typedef std::function<void()> JobFunc;
+
+	/*
+	Keeps count of how many of a group of jobs haven't finished yet. Jobs
+	can also be told to wait for a counter, and they'll only be started
+	once every job it's counting has finished - so a chain of jobs can be
+	handed over all at once, without anyone having to sit and wait between
+	each step.
+
+	A counter has to outlive everything counted by it, and everything
+	waiting for it - JobSystem::Wait is the easy way to make sure of that.
+	*/
+	class JobCounter {
+	public:
+		JobCounter() : count(0) {}
+
+		bool IsDone() const {
+			return count.load(std::memory_order_acquire) == 0;
+		}
+
+	protected:
+		friend class JobSystem;
+
+		struct Job {
+			JobFunc		func;
+			JobCounter* counter;
+		};
+
+		std::atomic<int>	count;
+		std::mutex			waitingMutex;
+		std::vector<Job>	waitingJobs;	//Started once the count gets back down to 0
+	};
+
+	/*
+	A pool of worker threads that share jobs out between themselves. Each
+	worker has its own queue, which it takes its newest job from first -
+	whatever it just queued is probably still in its cache - and when that
+	runs out, it steals the oldest jobs from everyone else's. Jobs queued
+	from threads that aren't workers go into a shared queue that everyone
+	takes from.
+
+	Any thread waiting for jobs to finish runs other jobs in the meantime,
+	rather than going to sleep, so jobs can safely start more jobs and wait
+	for them - a ParallelFor inside a ParallelFor is fine.
+
+	There's one shared JobSystem for everything to use, so that physics,
+	AI and rendering don't each start up a thread per core of their own.
+	*/
+	class JobSystem {
+	public:
+		//func(start, end, slot) - see ParallelFor
+		typedef std::function<void(size_t, size_t, unsigned int)> BatchFunc;
+
+		//A negative count uses one worker per hardware thread, minus the
+		//caller's - with 0, the calling thread does all of the work itself
+		JobSystem(int workerCount = -1);
+		~JobSystem();
+
+		static JobSystem& GetShared();
+
+		//Workers plus the calling thread
+		unsigned int GetThreadCount() const {
+			return (unsigned int)workers.size() + 1;
+		}
+
+		//If after is set, the job isn't started until after's jobs are all done
+		void Run(JobFunc func, JobCounter* counter = nullptr, JobCounter* after = nullptr);
+
+		//Runs other jobs until everything the counter is counting has finished
+		void Wait(JobCounter& counter);
+
+		/*
+		Splits a range of indices up into batches, and has the workers and
+		the calling thread take batches until they're all done - it doesn't
+		return until every batch has been processed. Each thread working on
+		the range is given its own slot, from 0 (the caller) up to
+		GetThreadCount() - 1, so that it can gather results without having
+		to lock anything. Which batches end up in which slot isn't fixed, so
+		anything that cares about the order results are produced in has to
+		sort that out itself afterwards.
+		*/
+		void ParallelFor(size_t count, size_t batchSize, const BatchFunc& func);
+
+	protected:
+		typedef JobCounter::Job Job;
+
+		struct JobQueue {
+			std::mutex		mutex;
+			std::deque<Job> jobs;
+		};
+
+		void WorkerLoop(unsigned int workerIndex);
+
+		void Push(Job&& job);
+		bool TakeJob(Job& job);
+		bool TryRunJob();
+		void Execute(Job& job);
+
+		std::vector<std::thread>				workers;
+		std::vector<std::unique_ptr<JobQueue>>	queues;	//One per worker, then the shared one
+
+		std::atomic<int>			pendingJobs;
+		std::mutex					sleepMutex;
+		std::condition_variable		jobAvailable;
+		bool						shuttingDown;
+	};
+
+	/*
+	A fast, thread local bump allocator, for jobs that need some memory to
+	work in but don't want to fight over the heap with every other thread.
+	Memory is handed back by rewinding to a marker, which frees everything
+	allocated since it was taken - a ScratchScope does this for you. The
+	blocks themselves are kept around, so after the first few frames
+	nothing is allocated at all. Nothing is constructed or destructed, so
+	only use it for plain data.
+	*/
+	class ScratchAllocator {
+	public:
+		struct Marker {
+			size_t block;
+			size_t offset;
+		};
+
+		ScratchAllocator(size_t blockSize = 64 * 1024);
+		~ScratchAllocator();
+
+		static ScratchAllocator& ForThisThread();
+
+		void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+		template<class T>
+		T* Allocate(size_t count) {
+			return (T*)Allocate(sizeof(T) * count, alignof(T));
+		}
+
+		Marker GetMarker() const {
+			return { currentBlock, offset };
+		}
+
+		void Release(const Marker& marker) {
+			currentBlock	= marker.block;
+			offset			= marker.offset;
+		}
+
+	protected:
+		struct Block {
+			std::unique_ptr<char[]> memory;
+			size_t					size;
+		};
+		std::vector<Block>	blocks;
+		size_t				currentBlock;
+		size_t				offset;
+		size_t				blockSize;
+	};
+
+	//Frees everything this thread allocated from its ScratchAllocator during the scope
+	class ScratchScope {
+	public:
+		ScratchScope() : allocator(ScratchAllocator::ForThisThread()), marker(allocator.GetMarker()) {
+		}
+
+		~ScratchScope() {
+			allocator.Release(marker);
+		}
+
+		ScratchAllocator& GetAllocator() {
+			return allocator;
+		}
+
+	protected:
+		ScratchAllocator&			allocator;
+		ScratchAllocator::Marker	marker;
+	};
+}